@@ -0,0 +1,128 @@
+// 2023 Green Rain Studios
+
+
+#include "SageScatterImporter.h"
+
+#include "SageScatter.h"
+#include "SageScatterPolylineReaders.h"
+#include "SplinePlacementActor.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+
+#if WITH_EDITOR
+#include "ScopedTransaction.h"
+#endif
+
+#define LOCTEXT_NAMESPACE "SageScatterImporter"
+
+namespace
+{
+	// Bytes read from disk at a time. Only the current chunk and the geometry being parsed are ever held in memory
+	constexpr int64 ImportChunkSize = 64 * 1024;
+}
+
+TArray<ASplinePlacementActor*> USageScatterImporter::ImportSplinesFromFile(ASplinePlacementActor* Target, const FString& FilePath,
+	ESplineImportFormat Format, FTransform CoordinateTransform, float MaxActorLength, bool bHasIdColumn)
+{
+	TArray<ASplinePlacementActor*> actors;
+	if(Target == nullptr || Target->GetWorld() == nullptr)
+		return actors;
+
+	TUniquePtr<FArchive> reader(IFileManager::Get().CreateFileReader(*FilePath));
+	if(!reader)
+	{
+		UE_LOG(LogSageScatter, Warning, TEXT("Could not open %s for spline import"), *FilePath);
+		return actors;
+	}
+
+#if WITH_EDITOR
+	// Covers the target's new points and every spawned copy, so undo removes the whole import
+	FScopedTransaction transaction(LOCTEXT("ImportSplines", "Import Splines"), !Target->GetWorld()->IsGameWorld());
+#endif
+
+	// Points are stored relative to the target, which every spawned copy shares the transform of
+	const FTransform actorTransform = Target->GetActorTransform();
+
+	// Hand a finished section to the next actor. The target is reused first, copies of it are spawned after that
+	auto commitSection = [&](const TArray<FVector>& Section)
+	{
+		if(Section.Num() < 2)
+			return;
+
+		if(actors.Num() == 0)
+		{
+			Target->Modify();
+			Target->SetSplinePointsBatched(Section, ESplineCoordinateSpace::Local);
+			actors.Add(Target);
+			return;
+		}
+
+		// Points go in before the components register, so registration runs the one and only placement pass
+		FActorSpawnParameters params;
+		params.Template = Target;
+		params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		params.CustomPreSpawnInitalization = [&Section](AActor* Actor)
+		{
+			CastChecked<ASplinePlacementActor>(Actor)->SetSplinePointsBatched(Section, ESplineCoordinateSpace::Local, false);
+		};
+
+		if(ASplinePlacementActor* actor = Target->GetWorld()->SpawnActor<ASplinePlacementActor>(Target->GetClass(), actorTransform, params))
+			actors.Add(actor);
+	};
+
+	TArray<FVector> section;
+	auto onPolyline = [&](TArray<FVector>& Points)
+	{
+		// Split into sections no longer than the max length. Consecutive sections share their end points
+		section.Reset();
+		float sectionLength = 0.f;
+		for(const FVector& point : Points)
+		{
+			const FVector localPoint = actorTransform.InverseTransformPosition(CoordinateTransform.TransformPosition(point));
+
+			// Duplicate points, common in GIS data, would give the spline zero length segments
+			if(section.Num() > 0 && localPoint.Equals(section.Last()))
+				continue;
+
+			if(section.Num() > 0)
+				sectionLength += FVector::Dist(section.Last(), localPoint);
+			section.Add(localPoint);
+
+			if(MaxActorLength > 0.f && sectionLength >= MaxActorLength)
+			{
+				commitSection(section);
+				section.Reset();
+				section.Add(localPoint);
+				sectionLength = 0.f;
+			}
+		}
+
+		commitSection(section);
+	};
+
+	FCsvPolylineReader csvReader(onPolyline, bHasIdColumn);
+	FGeoJsonPolylineReader geoJsonReader(onPolyline);
+
+	TArray<ANSICHAR> chunk;
+	chunk.SetNumUninitialized(ImportChunkSize);
+	for(int64 remaining = reader->TotalSize(); remaining > 0; remaining -= ImportChunkSize)
+	{
+		const int64 chunkSize = FMath::Min(remaining, ImportChunkSize);
+		reader->Serialize(chunk.GetData(), chunkSize);
+
+		if(Format == ESplineImportFormat::SIF_CSV)
+			csvReader.Consume(chunk.GetData(), chunkSize);
+		else
+			geoJsonReader.Consume(chunk.GetData(), chunkSize);
+	}
+
+	if(Format == ESplineImportFormat::SIF_CSV)
+		csvReader.Finish();
+	else
+		geoJsonReader.Finish();
+
+	UE_LOG(LogSageScatter, Log, TEXT("Imported %s into %d spline placement actors"), *FilePath, actors.Num());
+	return actors;
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,286 @@
+// 2023 Green Rain Studios
+
+
+#include "SageScatterPolylineReaders.h"
+
+namespace
+{
+	bool IsNumberChar(ANSICHAR Char)
+	{
+		return FCharAnsi::IsDigit(Char) || Char == '-' || Char == '+' || Char == '.' || Char == 'e' || Char == 'E';
+	}
+
+	// Parse a whole token as a number, rejecting anything with other characters in it. A lone sign, dot or exponent
+	// has no digits and would read as 0, so a token needs at least one
+	bool ParseNumber(TArray<ANSICHAR, TInlineAllocator<32>>& Token, double& OutValue)
+	{
+		bool bHasDigit = false;
+		for(const ANSICHAR Char : Token)
+		{
+			if(!IsNumberChar(Char))
+				return false;
+			bHasDigit |= FCharAnsi::IsDigit(Char);
+		}
+
+		if(!bHasDigit)
+			return false;
+
+		Token.Add('\0');
+		OutValue = FCStringAnsi::Atod(Token.GetData());
+		Token.Pop(false);
+		return true;
+	}
+}
+
+void FCsvPolylineReader::Consume(const ANSICHAR* Data, int64 Num)
+{
+	for(int64 i = 0; i < Num; i++)
+	{
+		if(Data[i] == '\n')
+		{
+			ParseLine();
+		}
+		else if(Data[i] != '\r')
+		{
+			Line.Add(Data[i]);
+		}
+	}
+}
+
+void FCsvPolylineReader::Finish()
+{
+	ParseLine();
+	EndPolyline();
+}
+
+void FCsvPolylineReader::ParseLine()
+{
+	// Split the row into trimmed fields
+	TArray<TArray<ANSICHAR, TInlineAllocator<32>>, TInlineAllocator<4>> fields;
+	fields.AddDefaulted();
+	for(const ANSICHAR Char : Line)
+	{
+		if(Char == ',')
+			fields.AddDefaulted();
+		else if(!FCharAnsi::IsWhitespace(Char) && Char != '"')
+			fields.Last().Add(Char);
+	}
+
+	Line.Reset();
+
+	// Blank rows end the current polyline
+	if(fields.Num() == 1 && fields[0].Num() == 0)
+	{
+		EndPolyline();
+		return;
+	}
+
+	// A changed id column also ends it
+	const int firstCoordinate = bHasIdColumn ? 1 : 0;
+	if(firstCoordinate == 1 && fields[0] != CurrentId)
+	{
+		EndPolyline();
+		CurrentId = fields[0];
+	}
+
+	FVector point = FVector::ZeroVector;
+	const int numCoordinates = FMath::Min(fields.Num() - firstCoordinate, 3);
+	if(numCoordinates < 2)
+		return;
+
+	for(int i = 0; i < numCoordinates; i++)
+	{
+		if(!ParseNumber(fields[firstCoordinate + i], point[i]))
+			return;
+	}
+
+	Points.Add(point);
+}
+
+void FCsvPolylineReader::EndPolyline()
+{
+	if(Points.Num() > 0)
+		OnPolyline(Points);
+	Points.Reset();
+}
+
+void FGeoJsonPolylineReader::Consume(const ANSICHAR* Data, int64 Num)
+{
+	for(int64 i = 0; i < Num; i++)
+	{
+		ConsumeChar(Data[i]);
+	}
+}
+
+void FGeoJsonPolylineReader::Finish()
+{
+	EndPolyline();
+	FlushPending(true);
+}
+
+void FGeoJsonPolylineReader::ConsumeChar(ANSICHAR Char)
+{
+	if(bInString)
+	{
+		if(bEscaped)
+			bEscaped = false;
+		else if(Char == '\\')
+			bEscaped = true;
+		else if(Char == '"')
+		{
+			bInString = false;
+			if(bExpectType)
+				SetGeometryType();
+
+			bLastStringIsCoordinates = FCStringAnsi::Strcmp(StringBuffer, "coordinates") == 0;
+			bLastStringIsType = FCStringAnsi::Strcmp(StringBuffer, "type") == 0;
+		}
+		else if(StringLength < UE_ARRAY_COUNT(StringBuffer) - 1)
+		{
+			StringBuffer[StringLength++] = Char;
+			StringBuffer[StringLength] = '\0';
+		}
+		return;
+	}
+
+	if(Frames.Num() > 0)
+	{
+		ConsumeCoordinateChar(Char);
+		return;
+	}
+
+	if(Char == '"')
+	{
+		bInString = true;
+		StringLength = 0;
+		StringBuffer[0] = '\0';
+	}
+	else if(Char == ':')
+	{
+		bExpectCoordinates = bLastStringIsCoordinates;
+		bExpectType = bLastStringIsType;
+	}
+	else if(Char == '[' && bExpectCoordinates)
+	{
+		Frames.AddDefaulted();
+	}
+	else if(!FCharAnsi::IsWhitespace(Char))
+	{
+		bExpectCoordinates = false;
+		bExpectType = false;
+	}
+
+	if(Char == '{')
+	{
+		ObjectDepth++;
+	}
+	else if(Char == '}')
+	{
+		// An object that never said what it is keeps its polylines
+		if(PendingDepth == ObjectDepth)
+			FlushPending(true);
+		if(TypeDepth == ObjectDepth)
+			TypeDepth = INDEX_NONE;
+		ObjectDepth--;
+	}
+
+	if(!FCharAnsi::IsWhitespace(Char) && Char != ':')
+	{
+		bLastStringIsCoordinates = false;
+		bLastStringIsType = false;
+	}
+}
+
+void FGeoJsonPolylineReader::SetGeometryType()
+{
+	bExpectType = false;
+	TypeDepth = ObjectDepth;
+	bPointGeometry = FCStringAnsi::Strcmp(StringBuffer, "Point") == 0 || FCStringAnsi::Strcmp(StringBuffer, "MultiPoint") == 0;
+
+	if(PendingDepth == ObjectDepth)
+		FlushPending(!bPointGeometry);
+}
+
+void FGeoJsonPolylineReader::ConsumeCoordinateChar(ANSICHAR Char)
+{
+	if(IsNumberChar(Char))
+	{
+		Number.Add(Char);
+		return;
+	}
+
+	EndNumber();
+	if(Char == '[')
+	{
+		Frames.AddDefaulted();
+	}
+	else if(Char == ']')
+	{
+		const FArrayFrame frame = Frames.Pop(false);
+		if(frame.bHasNumbers)
+		{
+			// A position, x and y with an optional z
+			if(Tuple.Num() >= 2)
+				Points.Add(FVector(Tuple[0], Tuple[1], Tuple.Num() > 2 ? Tuple[2] : 0.0));
+			Tuple.Reset();
+
+			if(Frames.Num() > 0)
+				Frames.Last().bHasPoints = true;
+		}
+		else if(frame.bHasPoints)
+		{
+			EndPolyline();
+		}
+
+		// Leaving the coordinates value
+		if(Frames.Num() == 0)
+		{
+			EndPolyline();
+			bExpectCoordinates = false;
+		}
+	}
+}
+
+void FGeoJsonPolylineReader::EndNumber()
+{
+	double value;
+	if(ParseNumber(Number, value))
+	{
+		Tuple.Add(value);
+		Frames.Last().bHasNumbers = true;
+	}
+
+	Number.Reset();
+}
+
+void FGeoJsonPolylineReader::EndPolyline()
+{
+	if(Points.Num() > 0)
+	{
+		if(TypeDepth != ObjectDepth)
+		{
+			PendingPolylines.Add(Points);
+			PendingDepth = ObjectDepth;
+		}
+		else if(!bPointGeometry)
+		{
+			OnPolyline(Points);
+		}
+	}
+
+	Points.Reset();
+}
+
+void FGeoJsonPolylineReader::FlushPending(bool bKeep)
+{
+	if(bKeep)
+	{
+		for(TArray<FVector>& polyline : PendingPolylines)
+		{
+			OnPolyline(polyline);
+		}
+	}
+
+	PendingPolylines.Reset();
+	PendingDepth = INDEX_NONE;
+}
@@ -0,0 +1,82 @@
+// 2023 Green Rain Studios
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Streaming parsers the spline importer feeds file chunks to. Chunks can split anywhere, including inside a number or
+// a row, and every finished polyline is handed to the callback as soon as it is complete
+
+// Builds CSV rows into polylines
+class FCsvPolylineReader
+{
+public:
+	FCsvPolylineReader(TFunctionRef<void(TArray<FVector>&)> InOnPolyline, bool bInHasIdColumn)
+		: OnPolyline(InOnPolyline), bHasIdColumn(bInHasIdColumn) {}
+
+	void Consume(const ANSICHAR* Data, int64 Num);
+	void Finish();
+
+private:
+	void ParseLine();
+	void EndPolyline();
+
+	TFunctionRef<void(TArray<FVector>&)> OnPolyline;
+	bool bHasIdColumn;
+	TArray<ANSICHAR> Line;
+	TArray<ANSICHAR, TInlineAllocator<32>> CurrentId;
+	TArray<FVector> Points;
+};
+
+// Pulls polylines out of GeoJSON coordinates without building a document. Any array of numbers under a
+// "coordinates" key is a point, and any array of points is a polyline, which covers every line and polygon type.
+// MultiPoint has the same shape as a line, so each object's "type" decides whether its coordinates are kept. When
+// the type comes after the coordinates, that object's polylines wait until it is read
+class FGeoJsonPolylineReader
+{
+public:
+	explicit FGeoJsonPolylineReader(TFunctionRef<void(TArray<FVector>&)> InOnPolyline) : OnPolyline(InOnPolyline) {}
+
+	void Consume(const ANSICHAR* Data, int64 Num);
+	void Finish();
+
+private:
+	// What an open array in the coordinates has directly contained so far
+	struct FArrayFrame
+	{
+		bool bHasNumbers = false;
+		bool bHasPoints = false;
+	};
+
+	void ConsumeChar(ANSICHAR Char);
+	void ConsumeCoordinateChar(ANSICHAR Char);
+	void SetGeometryType();
+	void EndNumber();
+	void EndPolyline();
+	void FlushPending(bool bKeep);
+
+	TFunctionRef<void(TArray<FVector>&)> OnPolyline;
+
+	ANSICHAR StringBuffer[16] = {};
+	int32 StringLength = 0;
+	bool bInString = false;
+	bool bEscaped = false;
+	bool bLastStringIsCoordinates = false;
+	bool bLastStringIsType = false;
+	bool bExpectCoordinates = false;
+	bool bExpectType = false;
+
+	// Object nesting, and the depth of the innermost object whose type is known
+	int32 ObjectDepth = 0;
+	int32 TypeDepth = INDEX_NONE;
+	bool bPointGeometry = false;
+
+	// Polylines of an object whose type has not been read yet
+	TArray<TArray<FVector>> PendingPolylines;
+	int32 PendingDepth = INDEX_NONE;
+
+	TArray<FArrayFrame, TInlineAllocator<4>> Frames;
+	TArray<ANSICHAR, TInlineAllocator<32>> Number;
+	TArray<double, TInlineAllocator<3>> Tuple;
+	TArray<FVector> Points;
+};
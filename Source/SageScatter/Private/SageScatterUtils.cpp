@@ -20,3 +20,105 @@ FRotator USageScatterUtils::MakeRotatorFromAxes(FVector Forward, FVector Right,
 
 	return RotMatrix.Rotator();
 }
+
+uint32 USageScatterUtils::HashTransform(const FTransform& Transform, uint32 Crc)
+{
+	// Locations to a tenth of a unit, rotation and scale to four decimals
+	const FVector location = Transform.GetLocation() * 10.0;
+	const FQuat rotation = Transform.GetRotation() * 10000.0;
+	const FVector scale = Transform.GetScale3D() * 10000.0;
+	
+	const int32 quantized[10] = {
+		FMath::RoundToInt32(location.X), FMath::RoundToInt32(location.Y), FMath::RoundToInt32(location.Z),
+		FMath::RoundToInt32(rotation.X), FMath::RoundToInt32(rotation.Y), FMath::RoundToInt32(rotation.Z), FMath::RoundToInt32(rotation.W),
+		FMath::RoundToInt32(scale.X), FMath::RoundToInt32(scale.Y), FMath::RoundToInt32(scale.Z)
+	};
+
+	return FCrc::MemCrc32(quantized, sizeof(quantized), Crc);
+}
+
+// SplitMix64 finalizer, cheap and with good avalanche for sequential inputs
+static uint64 MixBits(uint64 Value)
+{
+	Value = (Value ^ (Value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	Value = (Value ^ (Value >> 27)) * 0x94d049bb133111ebull;
+	return Value ^ (Value >> 31);
+}
+
+FSageScatterRandom::FSageScatterRandom(int32 Seed, int32 Profile, int32 Instance, int32 Channel)
+{
+	Key = MixBits(static_cast<uint32>(Seed));
+	Key = MixBits(Key ^ ((static_cast<uint64>(static_cast<uint32>(Profile)) << 32) | static_cast<uint32>(Channel)));
+	Key = MixBits(Key ^ static_cast<uint32>(Instance));
+}
+
+float FSageScatterRandom::GetFraction()
+{
+	// Top 24 bits fill the float mantissa exactly, so the result never rounds up to 1
+	const uint64 bits = MixBits(Key + 0x9e3779b97f4a7c15ull * ++Counter);
+	return static_cast<float>(bits >> 40) / static_cast<float>(1 << 24);
+}
+
+float FSageScatterRandom::GetInRange(float Min, float Max)
+{
+	return Min + (Max - Min) * GetFraction();
+}
+
+float FSageScatterRandom::GetSigned(float Extent)
+{
+	return GetInRange(-Extent, Extent);
+}
+
+void FSageScatterAliasTable::Build(TConstArrayView<float> Weights)
+{
+	Probabilities.Reset();
+	Aliases.Reset();
+
+	float totalWeight = 0.f;
+	for(const float weight : Weights)
+	{
+		totalWeight += FMath::Max(weight, 0.f);
+	}
+
+	if(totalWeight <= 0.f)
+		return;
+
+	const int num = Weights.Num();
+	Probabilities.SetNumUninitialized(num);
+	Aliases.SetNumUninitialized(num);
+
+	// Scale weights so the average is 1, then split into under and over full columns
+	TArray<int32, TInlineAllocator<16>> small, large;
+	for(int i = 0; i < num; i++)
+	{
+		Probabilities[i] = FMath::Max(Weights[i], 0.f) * num / totalWeight;
+		Aliases[i] = i;
+		(Probabilities[i] < 1.f ? small : large).Add(i);
+	}
+
+	// Top up every under full column with the remainder of an over full one
+	while(small.Num() > 0 && large.Num() > 0)
+	{
+		const int32 less = small.Pop(false);
+		const int32 more = large.Pop(false);
+
+		Aliases[less] = more;
+		Probabilities[more] -= 1.f - Probabilities[less];
+		(Probabilities[more] < 1.f ? small : large).Add(more);
+	}
+
+	// Anything left over is full, up to float error
+	for(const int32 i : small)
+		Probabilities[i] = 1.f;
+	for(const int32 i : large)
+		Probabilities[i] = 1.f;
+}
+
+int32 FSageScatterAliasTable::Pick(FSageScatterRandom& Random) const
+{
+	if(IsEmpty())
+		return INDEX_NONE;
+
+	const int32 column = FMath::Min(static_cast<int32>(Random.GetFraction() * Probabilities.Num()), Probabilities.Num() - 1);
+	return Random.GetFraction() < Probabilities[column] ? column : Aliases[column];
+}
@@ -0,0 +1,84 @@
+// 2023 Green Rain Studios
+
+
+#include "SplineCollisionComponent.h"
+
+#include "SageScatter.h"
+#include "Engine/CollisionProfile.h"
+#include "PhysicsEngine/BodySetup.h"
+
+DECLARE_CYCLE_STAT(TEXT("Collision Proxy Physics State"), STAT_CollisionProxyPhysicsState, STATGROUP_SageScatter);
+
+namespace
+{
+	bool IsSameGeometry(const FKAggregateGeom& A, const FKAggregateGeom& B)
+	{
+		if(A.BoxElems.Num() != B.BoxElems.Num() || A.ConvexElems.Num() != B.ConvexElems.Num() || A.GetElementCount() != B.GetElementCount())
+			return false;
+
+		for(int i = 0; i < A.BoxElems.Num(); i++)
+		{
+			const FKBoxElem& a = A.BoxElems[i];
+			const FKBoxElem& b = B.BoxElems[i];
+			if(a.Center != b.Center || a.Rotation != b.Rotation || a.X != b.X || a.Y != b.Y || a.Z != b.Z)
+				return false;
+		}
+
+		for(int i = 0; i < A.ConvexElems.Num(); i++)
+		{
+			if(A.ConvexElems[i].VertexData != B.ConvexElems[i].VertexData)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+USplineCollisionComponent::USplineCollisionComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	
+	SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	SetGenerateOverlapEvents(false);
+	bHiddenInGame = true;
+}
+
+void USplineCollisionComponent::SetCollisionGeometry(const FKAggregateGeom& Geometry)
+{
+	// Most rebuilds are for changes that leave the proxy where it was, so they cost nothing here
+	if(CollisionBodySetup != nullptr && IsSameGeometry(CollisionBodySetup->AggGeom, Geometry))
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_CollisionProxyPhysicsState);
+	
+	if(CollisionBodySetup == nullptr)
+	{
+		CollisionBodySetup = NewObject<UBodySetup>(this, NAME_None, RF_Transient);
+		CollisionBodySetup->BodySetupGuid = FGuid::NewGuid();
+		CollisionBodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+		CollisionBodySetup->bGenerateMirroredCollision = false;
+	}
+
+	// The body is torn down before its setup drops the old cooked convex data. Boxes need no cooking at all
+	DestroyPhysicsState();
+	CollisionBodySetup->InvalidatePhysicsData();
+	CollisionBodySetup->AggGeom = Geometry;
+	if(Geometry.ConvexElems.Num() > 0)
+		CollisionBodySetup->CreatePhysicsMeshes();
+
+	UpdateBounds();
+	CreatePhysicsState();
+}
+
+UBodySetup* USplineCollisionComponent::GetBodySetup()
+{
+	return CollisionBodySetup;
+}
+
+FBoxSphereBounds USplineCollisionComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	if(CollisionBodySetup == nullptr || CollisionBodySetup->AggGeom.GetElementCount() == 0)
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.f);
+
+	return FBoxSphereBounds(CollisionBodySetup->AggGeom.CalcAABB(LocalToWorld));
+}
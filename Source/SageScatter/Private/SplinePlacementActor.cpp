@@ -9,166 +9,1131 @@
 #include "Components/PointLightComponent.h"
 #include "Components/SpotLightComponent.h"
 #include "Components/SplineComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "SageScatter.h"
 #include "SageScatterUtils.h"
+#include "SplineCollisionComponent.h"
+#include "Algo/BinarySearch.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Net/UnrealNetwork.h"
+
+DECLARE_CYCLE_STAT(TEXT("Rebuild Placement"), STAT_RebuildPlacement, STATGROUP_SageScatter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Scratch Growth"), STAT_ScratchGrowth, STATGROUP_SageScatter);
+
+// Grow scratch memory to fit at least Num elements. Every growth is counted, so a steady state rebuild should leave
+// the stat untouched. Generated components and their physics data allocate outside of scratch and are not counted
+template <typename ArrayType>
+static void ReserveScratch(ArrayType& Array, int32 Num)
+{
+	if(Array.Max() < Num)
+	{
+		INC_DWORD_STAT(STAT_ScratchGrowth);
+		Array.Reserve(Num);
+	}
+}
+
+// Count growth of scratch memory that is filled on demand, since its size is only known once it has been filled
+template <typename ArrayType>
+static void CountScratchGrowth(const ArrayType& Array, int32 PreviousMax)
+{
+	if(Array.Max() != PreviousMax)
+		INC_DWORD_STAT(STAT_ScratchGrowth);
+}
+
+// Random channels, so each kind of variation draws from its own stream per instance
+enum ERandomChannel : int32
+{
+	RC_TRANSFORM,
+	RC_GAP,
+	RC_CUSTOM_DATA,
+	RC_MESH
+};
+
+// Sets default values
+ASplinePlacementActor::ASplinePlacementActor()
+{
+	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	PrimaryActorTick.bCanEverTick = true;
+
+	// Root spline component
+	Spline = CreateDefaultSubobject<USplineComponent>(TEXT("Spline"));
+	Spline->EditorUnselectedSplineSegmentColor = FLinearColor(0, 1.0, 0.376262);
+	Spline->EditorTangentColor = FLinearColor(0.921, 0.299687, 0);
+	RootComponent = Spline;
+
+	// Billboard for icon
+	static ConstructorHelpers::FObjectFinder<UTexture2D> ICN(TEXT("/Engine/EngineResources/Cursors/SplitterHorz.SplitterHorz"));	
+	Icn = CreateDefaultSubobject<UBillboardComponent>(TEXT("Icn"));
+	Icn->Sprite = ICN.Object;
+	Icn->bIsScreenSizeScaled = true;
+	Icn->ScreenSize = BILLBOARD_SPRITE_SIZE;
+	Icn->SetHiddenInGame(true);
+	Icn->SetupAttachment(RootComponent);
+
+	// Only placement inputs replicate. Level placed actors already match on every client so they stay dormant until
+	// the server rebuilds them
+	bReplicates = true;
+	NetDormancy = DORM_Initial;
+}
+
+template <typename T>
+T* ASplinePlacementActor::NewGeneratedComponent()
+{
+	// Generated components are rebuilt from the inputs, so they are never saved or recorded in transactions
+	T* component = NewObject<T>(this, NAME_None, RF_Transient);
+	component->ClearFlags(RF_Transactional);
+	component->AttachToComponent(RootComponent, FAttachmentTransformRules::SnapToTargetIncludingScale);
+	return component;
+}
+
+bool ASplinePlacementActor::IsGeneratedComponent(const UActorComponent* Component)
+{
+	// Anything created natively at runtime rather than as a default subobject or by a blueprint. This also catches
+	// components saved by older versions, from before they were transient
+	const bool bGeneratedType = Component->IsA<UHierarchicalInstancedStaticMeshComponent>() || Component->IsA<USplineMeshComponent>() || Component->IsA<ULocalLightComponent>() || Component->IsA<USplineCollisionComponent>();
+	return bGeneratedType && !Component->IsDefaultSubobject() && Component->CreationMethod == EComponentCreationMethod::Native;
+}
+
+// Called when the game starts or when spawned
+void ASplinePlacementActor::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Content is already generated on registration. Level placed actors stay dormant, but runtime spawned ones need
+	// their inputs sent to clients
+	if(HasAuthority() && !IsNetStartupActor())
+	{
+		FlushNetDormancy();
+	}
+}
+
+void ASplinePlacementActor::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	// Spawning with another actor as template copies its transient properties too, which would leave us pointing at its
+	// generated components. Start from nothing, so registration generates our own
+	for(FMeshProfileInstance& meshProfile : InstancedMeshes)
+	{
+		meshProfile.PLCs.Empty();
+		meshProfile.ISMs.Empty();
+	}
+
+	ISMs.Empty();
+	SMCs.Empty();
+	InstanceCollisionProxies.Empty();
+	SplineCollisionProxies.Empty();
+	InstanceIndex.Empty();
+	Chunks.Empty();
+	StreamingSpline = nullptr;
+}
+
+void ASplinePlacementActor::PostRegisterAllComponents()
+{
+	Super::PostRegisterAllComponents();
+
+	// Generated content is transient, so it has to be rebuilt whenever the actor is loaded, spawned or duplicated
+	const UWorld* world = GetWorld();
+	if(world != nullptr && !IsTemplate() && ISMs.Num() == 0 && SMCs.Num() == 0 && Chunks.Num() == 0)
+	{
+		DestroyGeneratedComponents();
+		RebuildPlacement();
+	}
+}
+
+void ASplinePlacementActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Chunk builds read from this actor on worker threads
+	WaitForChunkBuilds();
+	
+	Super::EndPlay(EndPlayReason);
+}
+
+void ASplinePlacementActor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ASplinePlacementActor, Seed);
+	DOREPLIFETIME(ASplinePlacementActor, InstancedMeshes);
+	DOREPLIFETIME(ASplinePlacementActor, SplineMeshes);
+	DOREPLIFETIME(ASplinePlacementActor, ReplicatedSpline);
+	DOREPLIFETIME(ASplinePlacementActor, ServerPlacementChecksum);
+}
+
+void ASplinePlacementActor::PostNetReceive()
+{
+	Super::PostNetReceive();
+
+	// Inputs can arrive as several properties in one update, so rebuild once after all of them are applied
+	if(bPendingNetRebuild)
+	{
+		bPendingNetRebuild = false;
+		bPendingChecksumCheck = true;
+		
+		ApplyReplicatedSpline();
+		RebuildPlacement();
+	}
+
+	if(bPendingChecksumCheck)
+	{
+		bPendingChecksumCheck = false;
+		VerifyPlacementChecksum();
+	}
+}
+
+void ASplinePlacementActor::RebuildPlacement()
+{
+	SCOPE_CYCLE_COUNTER(STAT_RebuildPlacement);
+	
+	ResetStreamingChunks();
+	
+	if(IsStreamingByDistance())
+	{
+		// Chunks own all content while streaming, and are generated as viewers come close. They insert their
+		// instances into the index as they finish, so it starts out with one empty entry per profile
+		DestroyGeneratedComponents();
+		InstanceIndex.SetNum(InstancedMeshes.Num());
+	}
+	else
+	{
+		RepopulateISMs();
+		PlaceInstancesAlongSpline();
+		RecalculateSplineMeshes();
+		PlaceSplineMeshComponentsAlongSpline();
+	}
+
+	// Push the new inputs to clients. Editor worlds have no clients, and must not save the replicated copy. Streamed
+	// content depends on where each viewer is, so there is no checksum to compare against. Rebuilding on load must not
+	// wake every dormant level placed actor, so only rebuilds after begin play flush dormancy
+	const UWorld* world = GetWorld();
+	if(HasAuthority() && world != nullptr && world->IsGameWorld())
+	{
+		CaptureReplicatedSpline();
+		ServerPlacementChecksum = IsStreamingByDistance() ? 0 : CalculatePlacementChecksum();
+		
+		if(HasActorBegunPlay())
+			FlushNetDormancy();
+	}
+}
+
+void ASplinePlacementActor::SetSplinePointsBatched(const TArray<FVector>& Points, ESplineCoordinateSpace::Type CoordinateSpace,
+	bool bRebuildPlacement)
+{
+	Spline->Modify();
+	Spline->SetSplinePoints(Points, CoordinateSpace, false);
+	Spline->UpdateSpline();
+
+	if(bRebuildPlacement)
+		RebuildPlacement();
+}
+
+void ASplinePlacementActor::CaptureReplicatedSpline()
+{
+	ReplicatedSpline.Points.Reset(Spline->GetNumberOfSplinePoints());
+	for(int i = 0; i < Spline->GetNumberOfSplinePoints(); i++)
+	{
+		ReplicatedSpline.Points.Add(Spline->GetSplinePointAt(i, ESplineCoordinateSpace::Local));
+	}
+	
+	ReplicatedSpline.bClosedLoop = Spline->IsClosedLoop();
+}
+
+void ASplinePlacementActor::ApplyReplicatedSpline()
+{
+	// Profiles can replicate without a spline for actors the server never rebuilt, keep the local spline then
+	if(ReplicatedSpline.Points.Num() == 0)
+		return;
+
+	// Rebuild the spline in one batch so it only updates once
+	Spline->ClearSplinePoints(false);
+	Spline->AddPoints(ReplicatedSpline.Points, false);
+	Spline->SetClosedLoop(ReplicatedSpline.bClosedLoop, false);
+	Spline->UpdateSpline();
+}
+
+void ASplinePlacementActor::VerifyPlacementChecksum()
+{
+	if(ServerPlacementChecksum == 0)
+		return;
+
+	const uint32 localChecksum = CalculatePlacementChecksum();
+	if(localChecksum != ServerPlacementChecksum)
+	{
+		UE_LOG(LogSageScatter, Warning, TEXT("%s: placement diverged from server (local checksum %08x, server checksum %08x)"), *GetName(), localChecksum, ServerPlacementChecksum);
+	}
+}
+
+uint32 ASplinePlacementActor::CalculatePlacementChecksum() const
+{
+	uint32 crc = 0;
+	
+	// Walk profiles rather than the flat ISM list so the order does not depend on component creation
+	for(const FMeshProfileInstance& meshProfile : InstancedMeshes)
+	{
+		for(const UHierarchicalInstancedStaticMeshComponent* ism : meshProfile.ISMs)
+		{
+			if(ism == nullptr)
+				continue;
+			
+			for(int i = 0; i < ism->GetInstanceCount(); i++)
+			{
+				FTransform transform;
+				ism->GetInstanceTransform(i, transform);
+				crc = USageScatterUtils::HashTransform(transform, crc);
+			}
+		}
+	}
+
+	for(const USplineMeshComponent* smc : SMCs)
+	{
+		crc = USageScatterUtils::HashTransform(FTransform(smc->GetStartPosition()), crc);
+		crc = USageScatterUtils::HashTransform(FTransform(smc->GetEndPosition()), crc);
+	}
+
+	return crc;
+}
+
+void ASplinePlacementActor::OnRep_PlacementInputs()
+{
+	bPendingNetRebuild = true;
+}
+
+void ASplinePlacementActor::OnRep_PlacementChecksum()
+{
+	bPendingChecksumCheck = true;
+}
+
+bool ASplinePlacementActor::IsStreamingByDistance() const
+{
+	const UWorld* world = GetWorld();
+	return bStreamByDistance && world != nullptr && world->IsGameWorld();
+}
+
+void ASplinePlacementActor::DestroyGeneratedComponents()
+{
+	// Look at the owned components rather than our arrays, since transient arrays are not restored by undo
+	TInlineComponentArray<UActorComponent*> components(this);
+	for(UActorComponent* component : components)
+	{
+		if(IsGeneratedComponent(component))
+		{
+			component->UnregisterComponent();
+			component->DestroyComponent();
+		}
+	}
+
+	for(FMeshProfileInstance& meshProfile : InstancedMeshes)
+	{
+		meshProfile.PLCs.Empty();
+		meshProfile.ISMs.Empty();
+	}
+	
+	ISMs.Empty();
+	SMCs.Empty();
+	InstanceCollisionProxies.Empty();
+	SplineCollisionProxies.Empty();
+	InstanceIndex.Empty();
+}
+
+void ASplinePlacementActor::ResetStreamingChunks()
+{
+	// Throw away everything streamed for the previous inputs
+	WaitForChunkBuilds();
+	for(int i = 0; i < Chunks.Num(); i++)
+	{
+		UnloadChunk(i);
+	}
+	
+	Chunks.Empty();
+	StreamingSnapshot.Reset();
+	StreamingSpline = nullptr;
+	StreamingUpdateTimer = 0.f;
+
+	if(!IsStreamingByDistance())
+		return;
+
+	// Worker threads read all of their inputs, the spline included, from a copy, so replication and spline edits never
+	// race with a build
+	StreamingSpline = DuplicateObject<USplineComponent>(Spline, GetTransientPackage());
+	
+	TSharedRef<FPlacementSnapshot> snapshot = MakeShared<FPlacementSnapshot>();
+	snapshot->Spline = StreamingSpline;
+	snapshot->ActorLocation = GetActorLocation();
+	snapshot->Seed = Seed;
+	snapshot->SplineLength = Spline->GetSplineLength();
+	snapshot->InstancedMeshes = InstancedMeshes;
+	snapshot->SplineMeshes = SplineMeshes;
+	snapshot->MeshTables.SetNum(InstancedMeshes.Num());
+	for(int i = 0; i < InstancedMeshes.Num(); i++)
+	{
+		BuildMeshTable(InstancedMeshes[i], snapshot->MeshTables[i]);
+	}
+
+	// Split the spline into chunks. The last one is open ended so it also owns anything placed past the spline's end
+	const float splineLength = snapshot->SplineLength;
+	const float chunkLength = FMath::Max(StreamingChunkLength, 100.f);
+	const int numChunks = FMath::Max(FMath::CeilToInt(splineLength / chunkLength), 1);
+	Chunks.SetNum(numChunks);
+	
+	for(int i = 0; i < numChunks; i++)
+	{
+		FPlacementChunk& chunk = Chunks[i];
+		chunk.StartDistance = i * chunkLength;
+		chunk.EndDistance = i == numChunks - 1 ? TNumericLimits<float>::Max() : (i + 1) * chunkLength;
+
+		// Bound the chunk by sampling the spline across its range
+		constexpr int numSamples = 8;
+		const float sampleEnd = FMath::Min(chunk.EndDistance, splineLength);
+		FBox bounds(ForceInit);
+		for(int j = 0; j <= numSamples; j++)
+		{
+			const float dist = FMath::Lerp(chunk.StartDistance, sampleEnd, static_cast<float>(j) / numSamples);
+			bounds += Spline->GetLocationAtDistanceAlongSpline(dist, ESplineCoordinateSpace::World);
+		}
+
+		chunk.Center = bounds.GetCenter();
+		chunk.Radius = bounds.GetExtent().Size();
+	}
+
+	// Record where every gap walk enters each chunk in one pass over the whole spline, so a chunk build only walks its
+	// own range. Merged collision spans from a profile's first to its last placement like in a full build, and chunks
+	// clip that span to their own range, so the pass also finds where each profile's placements end
+	snapshot->ChunkStarts.SetNum(InstancedMeshes.Num());
+	snapshot->CollisionRanges.SetNumZeroed(InstancedMeshes.Num());
+	for(int i = 0; i < InstancedMeshes.Num(); i++)
+	{
+		const FMeshProfileInstance& meshProfile = InstancedMeshes[i];
+		const FSageScatterAliasTable& meshTable = snapshot->MeshTables[i];
+		if(meshTable.IsEmpty())
+			continue;
+
+		const float halfLength = GetScaledMeshBox(meshProfile).GetExtent().X;
+		if(meshProfile.PlacementType != EInstancePlacementType::IPT_GAP || GetMinScaledMeshHalfLength(meshProfile) * 2 > splineLength)
+		{
+			// Placed at the spline points, the first of which is at the start
+			const int32 numPoints = Spline->GetNumberOfSplinePoints();
+			if(numPoints > 0)
+			{
+				const float lastPointDistance = Spline->GetDistanceAlongSplineAtSplinePoint(numPoints - 1);
+				snapshot->CollisionRanges[i] = FVector2D(0.f, FMath::Min(lastPointDistance + halfLength, splineLength));
+			}
+			
+			continue;
+		}
+
+		TArray<FGapWalkState>& starts = snapshot->ChunkStarts[i];
+		starts.SetNum(numChunks);
+		
+		FGapWalkState state;
+		state.Distance = meshProfile.StartOffset;
+		int32 meshIdx = PickInstanceMesh(Seed, i, 0, meshTable);
+		float lastDistance = -1.f;
+		for(int j = 0; j < numChunks || state.Distance <= splineLength;)
+		{
+			// The walk stops at the spline's end, so every chunk past it starts there too
+			if(j < numChunks && (state.Distance >= Chunks[j].StartDistance || state.Distance > splineLength))
+			{
+				starts[j++] = state;
+				continue;
+			}
+
+			// Anything the walk steps from is placed
+			lastDistance = state.Distance;
+			
+			int32 nextMeshIdx;
+			state.Distance += StepGapWalk(Seed, i, meshProfile, meshTable, state.InstanceIdx, meshIdx, nextMeshIdx);
+			state.InstanceIdx++;
+			meshIdx = nextMeshIdx;
+		}
+
+		if(lastDistance >= 0.f)
+			snapshot->CollisionRanges[i] = FVector2D(FMath::Max(meshProfile.StartOffset - halfLength, 0.f), FMath::Min(lastDistance + halfLength, splineLength));
+	}
+
+	StreamingSnapshot = snapshot;
+}
+
+void ASplinePlacementActor::UpdateStreamingChunks()
+{
+	// Every player controller is a streaming source. Clients only have their local ones
+	TArray<FVector, TInlineAllocator<4>> viewers;
+	for(FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it)
+	{
+		if(const APlayerController* pc = it->Get())
+		{
+			FVector location;
+			FRotator rotation;
+			pc->GetPlayerViewPoint(location, rotation);
+			viewers.Add(location);
+		}
+	}
+
+	const float unloadDistance = StreamingDistance + StreamingHysteresis;
+	for(int i = 0; i < Chunks.Num(); i++)
+	{
+		FPlacementChunk& chunk = Chunks[i];
+		
+		float nearest = TNumericLimits<float>::Max();
+		for(const FVector& viewer : viewers)
+		{
+			nearest = FMath::Min<float>(nearest, FMath::Max<float>(FVector::Dist(viewer, chunk.Center) - chunk.Radius, 0.f));
+		}
+
+		// Between the two distances a chunk keeps its current state, so viewers on the edge do not thrash it
+		if(nearest <= StreamingDistance)
+			chunk.bWanted = true;
+		else if(nearest > unloadDistance)
+			chunk.bWanted = false;
+
+		if(!chunk.bWanted && chunk.bResident)
+			UnloadChunk(i);
+	}
+
+	for(int i = 0; i < Chunks.Num() && ChunkBuilds.Num() < MaxPendingChunkBuilds; i++)
+	{
+		if(Chunks[i].bWanted && !Chunks[i].bPending && !Chunks[i].bResident)
+			StartChunkBuild(i);
+	}
+}
+
+void ASplinePlacementActor::StartChunkBuild(int32 ChunkIdx)
+{
+	FPlacementChunk& chunk = Chunks[ChunkIdx];
+	chunk.bPending = true;
+
+	// Builds only read the snapshot, never this actor or its live spline, which the game thread keeps changing. They
+	// are always waited on before the snapshot's spline copy is released
+	TSharedPtr<const FPlacementSnapshot> snapshot = StreamingSnapshot;
+	const float minDistance = chunk.StartDistance;
+	const float maxDistance = chunk.EndDistance;
+	ChunkBuilds.Add(Async(EAsyncExecution::ThreadPool, [snapshot, ChunkIdx, minDistance, maxDistance]()
+	{
+		FChunkBuildResult result;
+		FCollisionProxySamples proxySamples;
+		result.ChunkIdx = ChunkIdx;
+		result.Instances.SetNum(snapshot->InstancedMeshes.Num());
+		for(int i = 0; i < snapshot->InstancedMeshes.Num(); i++)
+		{
+			const FMeshProfileInstance& meshProfile = snapshot->InstancedMeshes[i];
+			if(snapshot->MeshTables[i].IsEmpty())
+				continue;
+			
+			// Gap placement picks up the walk where it enters this chunk
+			const FGapWalkState* gapStart = snapshot->ChunkStarts[i].IsValidIndex(ChunkIdx) ? &snapshot->ChunkStarts[i][ChunkIdx] : nullptr;
+			
+			TArray<FInstancePlacement>& placements = result.Instances[i];
+			CalculateProfilePlacements(snapshot->Spline, snapshot->Seed, snapshot->SplineLength, i, meshProfile, snapshot->MeshTables[i], gapStart, minDistance, maxDistance, placements);
+
+			// Merged collision for the part of the profile inside this chunk
+			const float startDistance = FMath::Max<float>(snapshot->CollisionRanges[i].X, minDistance);
+			const float endDistance = FMath::Min<float>(snapshot->CollisionRanges[i].Y, maxDistance);
+			if(meshProfile.MeshData.CollisionMode == EPlacementCollisionMode::PCM_MERGED && endDistance > startDistance)
+			{
+				const FBox meshBox = GetScaledMeshBox(meshProfile);
+				CalculateCollisionProxy(snapshot->Spline, meshProfile.MeshData, meshBox, startDistance, endDistance, proxySamples, result.CollisionProxies.AddDefaulted_GetRef());
+			}
+		}
+		
+		CalculateSplineMeshSegments(snapshot->Spline, snapshot->ActorLocation, snapshot->SplineMeshes, minDistance, maxDistance, result.Segments);
+		
+		for(const FMeshProfileSpline& splineMeshProfile : snapshot->SplineMeshes)
+		{
+			if(splineMeshProfile.MeshData.CollisionMode != EPlacementCollisionMode::PCM_MERGED || splineMeshProfile.MeshData.Mesh == nullptr)
+				continue;
+
+			float startDistance, endDistance;
+			GetSplineMeshProfileRange(splineMeshProfile, snapshot->SplineLength, startDistance, endDistance);
+			startDistance = FMath::Max(startDistance, minDistance);
+			endDistance = FMath::Min(endDistance, maxDistance);
+			if(endDistance > startDistance)
+				CalculateCollisionProxy(snapshot->Spline, splineMeshProfile.MeshData, GetScaledMeshBox(splineMeshProfile.MeshData, splineMeshProfile.MeshData.Mesh), startDistance, endDistance, proxySamples, result.CollisionProxies.AddDefaulted_GetRef());
+		}
+		
+		return result;
+	}));
+}
+
+void ASplinePlacementActor::FinishChunkBuild(FChunkBuildResult& Result)
+{
+	FPlacementChunk& chunk = Chunks[Result.ChunkIdx];
+	chunk.bPending = false;
+
+	// Viewers may have moved away while this was building
+	if(!chunk.bWanted)
+		return;
+
+	for(int i = 0; i < Result.Instances.Num(); i++)
+	{
+		TArray<FInstancePlacement>& placements = Result.Instances[i];
+		if(placements.Num() == 0)
+			continue;
+		
+		const FMeshProfileInstance& meshProfile = StreamingSnapshot->InstancedMeshes[i];
+
+		// Only create ISMs for meshes this chunk actually uses
+		TArray<UHierarchicalInstancedStaticMeshComponent*> meshISMs;
+		meshISMs.SetNumZeroed(meshProfile.GetNumMeshes());
+		for(const FInstancePlacement& placement : placements)
+		{
+			if(meshISMs[placement.MeshIdx] != nullptr)
+				continue;
+			
+			UHierarchicalInstancedStaticMeshComponent* ism = NewGeneratedComponent<UHierarchicalInstancedStaticMeshComponent>();
+			ism->SetStaticMesh(meshProfile.GetMesh(placement.MeshIdx));
+			ism->SetCollisionEnabled(GetGeneratedCollision(meshProfile.MeshData));
+			ism->RegisterComponent();
+			meshISMs[placement.MeshIdx] = ism;
+			chunk.Components.Add(ism);
+		}
+
+		AddPlacementsToISMs(meshISMs, placements);
+		ApplyInstanceCustomData(StreamingSnapshot->Seed, i, meshProfile, meshISMs, placements);
+
+		TArray<ULocalLightComponent*> lights;
+		if(meshProfile.bActivateLight)
+		{
+			lights.Reserve(placements.Num());
+			for(const FInstancePlacement& placement : placements)
+			{
+				ULocalLightComponent* ll = CreateLC(meshProfile.LightData);
+				ll->SetRelativeTransform(CalculateLightTransform(meshProfile.LightData, placement.Transform));
+				UpdateLightPropertiesFromProfile(meshProfile.LightData, ll);
+				chunk.Components.Add(ll);
+				lights.Add(ll);
+			}
+		}
+
+		IndexPlacements(i, placements, meshISMs, lights);
+	}
+
+	for(const FSplineMeshSegment& segment : Result.Segments)
+	{
+		USplineMeshComponent* smc = NewGeneratedComponent<USplineMeshComponent>();
+		smc->SetStaticMesh(segment.Mesh);
+		smc->SetStartAndEnd(segment.StartLocation, segment.StartTangent, segment.EndLocation, segment.EndTangent);
+		smc->SetCollisionEnabled(segment.CollisionMode == EPlacementCollisionMode::PCM_PER_INSTANCE ? ECollisionEnabled::QueryAndPhysics : ECollisionEnabled::NoCollision);
+		smc->RegisterComponent();
+		chunk.Components.Add(smc);
+	}
+
+	for(const FKAggregateGeom& geometry : Result.CollisionProxies)
+	{
+		if(geometry.GetElementCount() == 0)
+			continue;
+		
+		USplineCollisionComponent* proxy = NewGeneratedComponent<USplineCollisionComponent>();
+		proxy->RegisterComponent();
+		proxy->SetCollisionGeometry(geometry);
+		chunk.Components.Add(proxy);
+	}
+
+	chunk.bResident = true;
+}
+
+void ASplinePlacementActor::UnloadChunk(int32 ChunkIdx)
+{
+	FPlacementChunk& chunk = Chunks[ChunkIdx];
+	for(UActorComponent* component : chunk.Components)
+	{
+		component->UnregisterComponent();
+		component->DestroyComponent();
+	}
+	
+	chunk.Components.Empty();
+	chunk.bResident = false;
+	RemoveIndexedRange(chunk.StartDistance, chunk.EndDistance);
+}
+
+void ASplinePlacementActor::WaitForChunkBuilds()
+{
+	for(TFuture<FChunkBuildResult>& build : ChunkBuilds)
+	{
+		build.Wait();
+	}
+	
+	ChunkBuilds.Empty();
+	for(FPlacementChunk& chunk : Chunks)
+	{
+		chunk.bPending = false;
+	}
+}
+
+void ASplinePlacementActor::RepopulateISMs()
+{
+	// The ISMs of the previous build are handed out again in order, so only the difference is created or destroyed.
+	// Undo and load destroy all generated components first, so our array is all there is
+	ISMs.RemoveAll([](const UHierarchicalInstancedStaticMeshComponent* ism) { return !IsValid(ism); });
+	int numUsed = 0;
+
+	// Iterate and assign an ISM to each mesh of each profile
+	for(int i = 0; i < InstancedMeshes.Num(); i++)
+	{
+		InstancedMeshes[i].ISMs.Reset();
+		
+		for(int j = 0; j < InstancedMeshes[i].GetNumMeshes(); j++)
+		{
+			// Keep a null entry for unset meshes so ISMs stay indexed by mesh
+			UStaticMesh* mesh = InstancedMeshes[i].GetMesh(j);
+			if(mesh == nullptr)
+			{
+				InstancedMeshes[i].ISMs.Add(nullptr);
+				continue;
+			}
+
+			UHierarchicalInstancedStaticMeshComponent* ism;
+			if(numUsed < ISMs.Num())
+			{
+				ism = ISMs[numUsed];
+				ism->SetStaticMesh(mesh);
+				ism->SetCollisionEnabled(GetGeneratedCollision(InstancedMeshes[i].MeshData));
+			}
+			else
+			{
+				ism = NewGeneratedComponent<UHierarchicalInstancedStaticMeshComponent>();
+				ism->SetStaticMesh(mesh);
+				ism->SetCollisionEnabled(GetGeneratedCollision(InstancedMeshes[i].MeshData));
+				ism->RegisterComponent();
+				ISMs.Add(ism);
+			}
+
+			InstancedMeshes[i].ISMs.Add(ism);
+			numUsed++;
+		}
+	}
+
+	// Delete the ISMs no longer needed
+	for(int i = numUsed; i < ISMs.Num(); i++)
+	{
+		ISMs[i]->UnregisterComponent();
+		ISMs[i]->DestroyComponent();
+	}
+
+	ISMs.SetNum(numUsed, false);
+}
+
+void ASplinePlacementActor::PlaceInstancesAlongSpline()
+{
+	// First we clear all ISMs of their instances
+	for(int i = 0; i < ISMs.Num(); i++)
+	{
+		ISMs[i]->ClearInstances();
+	}
+
+	// Then we populate based on total length of spline
+	const float splineLength = Spline->GetSplineLength();
+
+	// Keep each profile's index array, and with it its memory
+	InstanceIndex.SetNum(InstancedMeshes.Num(), false);
+	for(FProfileInstanceIndex& index : InstanceIndex)
+	{
+		index.Instances.Reset();
+	}
+
+	ResizeCollisionProxies(InstanceCollisionProxies, InstancedMeshes.Num());
+	ReserveScratch(Scratch.InstanceProxyGeometry, InstancedMeshes.Num());
+	Scratch.InstanceProxyGeometry.SetNum(InstancedMeshes.Num());
+
+	for(int i = 0; i < InstancedMeshes.Num(); i++)
+	{
+		// Error checking. If the ISMs are out of date with the profile, skip this one
+		FMeshProfileInstance& meshProfile = InstancedMeshes[i];
+		if(meshProfile.ISMs.Num() != meshProfile.GetNumMeshes())
+		{
+			DestroyCollisionProxy(InstanceCollisionProxies[i]);
+			continue;
+		}
+
+		// If no mesh can be picked then skip this one
+		FSageScatterAliasTable& meshTable = Scratch.MeshTable;
+		BuildMeshTable(meshProfile, meshTable);
+		if(meshTable.IsEmpty())
+		{
+			DestroyCollisionProxy(InstanceCollisionProxies[i]);
+			continue;
+		}
+
+		// Placements keep the capacity of the largest profile of earlier rebuilds, so they only grow with the inputs
+		TArray<FInstancePlacement>& placements = Scratch.Placements;
+		const int32 placementsMax = placements.Max();
+		placements.Reset();
+		CalculateProfilePlacements(Spline, Seed, splineLength, i, meshProfile, meshTable, nullptr, 0.f, TNumericLimits<float>::Max(), placements);
+		CountScratchGrowth(placements, placementsMax);
+		AddPlacementsToISMs(meshProfile.ISMs, placements);
+		
+		ApplyInstanceCustomData(Seed, i, meshProfile, meshProfile.ISMs, placements);
+		CreateLCs(i, placements.Num());
+		UpdateLCs(i, placements);
+		IndexPlacements(i, placements, meshProfile.ISMs, meshProfile.PLCs);
+
+		// Merged collision covers the placed instances end to end, including their own half lengths
+		const FBox meshBox = GetScaledMeshBox(meshProfile);
+		const float startDistance = placements.Num() > 0 ? FMath::Max(placements[0].Distance - meshBox.GetExtent().X, 0.f) : 0.f;
+		const float endDistance = placements.Num() > 0 ? FMath::Min(placements.Last().Distance + meshBox.GetExtent().X, splineLength) : 0.f;
+		UpdateCollisionProxy(InstanceCollisionProxies[i], Scratch.InstanceProxyGeometry[i], meshProfile.MeshData, meshBox, startDistance, endDistance);
+	}
+}
+
+void ASplinePlacementActor::CalculateProfilePlacements(const USplineComponent* InSpline, int32 InSeed, float SplineLength, int ProfileIdx, const FMeshProfileInstance& MeshProfile,
+	const FSageScatterAliasTable& MeshTable, const FGapWalkState* GapStart, float MinDistance, float MaxDistance, TArray<FInstancePlacement>& OutPlacements)
+{
+	// Different placement types will generate different lists of placements
+	switch (MeshProfile.PlacementType)
+	{
+	case EInstancePlacementType::IPT_GAP:
+		if(CalculateTransformsAtRegularDistances(InSpline, InSeed, SplineLength, ProfileIdx, MeshProfile, MeshTable, GapStart, MinDistance, MaxDistance, OutPlacements))
+			break;
+
+	case EInstancePlacementType::IPT_POINT:
+		if(CalculateTransformsAtSplinePoints(InSpline, InSeed, ProfileIdx, MeshProfile, MeshTable, MinDistance, MaxDistance, OutPlacements))
+		 	break;
+	}
+}
+
+bool ASplinePlacementActor::CalculateTransformsAtRegularDistances(const USplineComponent* InSpline, int32 InSeed, float SplineLength, int ProfileIdx, const FMeshProfileInstance& MeshProfile,
+	const FSageScatterAliasTable& MeshTable, const FGapWalkState* GapStart, float MinDistance, float MaxDistance, TArray<FInstancePlacement> &OutPlacements)
+{
+	// If even the shortest pickable mesh is larger than the current spline length, we will return without placing
+	// anything. Checking the mesh actually picked would make the placement type depend on the seed
+	if(GetMinScaledMeshHalfLength(MeshProfile)*2 > SplineLength)
+		return false;
+
+	// Distances are accumulated serially since gap jitter and per mesh bounds make every step depend on the previous
+	// ones. Ranges further along the spline pick the walk up from a state recorded for them, and only keep what they need
+	const int32 firstPlacement = OutPlacements.Num();
+	int32 instanceIdx = GapStart != nullptr ? GapStart->InstanceIdx : 0;
+	float dist = GapStart != nullptr ? GapStart->Distance : MeshProfile.StartOffset;
+	int32 meshIdx = PickInstanceMesh(InSeed, ProfileIdx, instanceIdx, MeshTable);
+	for(; dist <= SplineLength && dist < MaxDistance; instanceIdx++)
+	{
+		if(dist >= MinDistance)
+		{
+			FInstancePlacement& placement = OutPlacements.AddDefaulted_GetRef();
+			placement.Distance = dist;
+			placement.InstanceIdx = instanceIdx;
+			placement.MeshIdx = meshIdx;
+		}
+
+		int32 nextMeshIdx;
+		dist += StepGapWalk(InSeed, ProfileIdx, MeshProfile, MeshTable, instanceIdx, meshIdx, nextMeshIdx);
+		meshIdx = nextMeshIdx;
+	}
+
+	// Every instance only depends on its own distance and random stream, so evaluate them in parallel
+	ParallelFor(OutPlacements.Num() - firstPlacement, [&](int32 i)
+	{
+		FInstancePlacement& placement = OutPlacements[firstPlacement + i];
+		FTransform transform = GetTransformAtDistanceAlongSpline(InSpline, placement.Distance);
+
+		// Cache fwd, up, right vectors
+		FVector fwd, right, up;
+		GetDirectionVectorsAtDistanceAlongSpline(InSpline, placement.Distance, fwd, right, up);
+		
+		// Calculate location, rotation, and scale
+		FVector location = transform.GetLocation() + USageScatterUtils::CalculateOffsets(MeshProfile.MeshData.Offset.GetLocation(), fwd, right, up);
+		FRotator rotation =  transform.GetRotation().Rotator() + MeshProfile.MeshData.Offset.GetRotation().Rotator();
+		FVector scale = transform.GetScale3D() * MeshProfile.MeshData.Offset.GetScale3D();
+
+		FSageScatterRandom random(InSeed, ProfileIdx, placement.InstanceIdx, RC_TRANSFORM);
+		ApplyInstanceVariation(MeshProfile.Variation, random, fwd, right, up, location, rotation, scale);
+
+		placement.Transform = FTransform(rotation, location, scale);
+	});
+
+	return true;
+}
+
+bool ASplinePlacementActor::CalculateTransformsAtSplinePoints(const USplineComponent* InSpline, int32 InSeed, int ProfileIdx, const FMeshProfileInstance& MeshProfile,
+	const FSageScatterAliasTable& MeshTable, float MinDistance, float MaxDistance, TArray<FInstancePlacement>& OutPlacements)
+{
+	int numPoints = InSpline->GetNumberOfSplinePoints();
+
+	// Point distances grow with their index, so search for the first point in range rather than testing them all
+	int firstPoint = 0;
+	for(int count = numPoints; count > 0;)
+	{
+		const int step = count / 2;
+		if(InSpline->GetDistanceAlongSplineAtSplinePoint(firstPoint + step) < MinDistance)
+		{
+			firstPoint += step + 1;
+			count -= step + 1;
+		}
+		else
+		{
+			count = step;
+		}
+	}
+	
+	// Iterate with number of spline points to generate transforms at those locations
+	for(int i = firstPoint; i < numPoints; i++)
+	{
+		float dist = InSpline->GetDistanceAlongSplineAtSplinePoint(i);
+		if(dist >= MaxDistance)
+			break;
+
+		// Cache fwd, up, right vectors
+		FVector fwd, right, up;
+		GetDirectionVectorsAtDistanceAlongSpline(InSpline, dist, fwd, right, up);
+		
+		FVector location = InSpline->GetLocationAtSplinePoint(i, ESplineCoordinateSpace::Local) + USageScatterUtils::CalculateOffsets(MeshProfile.MeshData.Offset.GetLocation(), fwd, right, up);
+		FRotator rotation = InSpline->GetRotationAtSplinePoint(i, ESplineCoordinateSpace::Local) + MeshProfile.MeshData.Offset.GetRotation().Rotator();
+		FVector scale = InSpline->GetScaleAtSplinePoint(i) * MeshProfile.MeshData.Offset.GetScale3D();
+
+		FSageScatterRandom random(InSeed, ProfileIdx, i, RC_TRANSFORM);
+		ApplyInstanceVariation(MeshProfile.Variation, random, fwd, right, up, location, rotation, scale);
+
+		FInstancePlacement& placement = OutPlacements.AddDefaulted_GetRef();
+		placement.Transform = FTransform(rotation, location, scale);
+		placement.Distance = dist;
+		placement.InstanceIdx = i;
+		placement.MeshIdx = PickInstanceMesh(InSeed, ProfileIdx, i, MeshTable);
+	}
 
+	return true;
+}
 
-// Sets default values
-ASplinePlacementActor::ASplinePlacementActor()
+void ASplinePlacementActor::AddPlacementsToISMs(const TArray<UHierarchicalInstancedStaticMeshComponent*>& MeshISMs,
+	TArray<FInstancePlacement>& Placements)
 {
-	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// Count placements per picked mesh first, so every bucket is sized once
+	TArray<int32>& counts = Scratch.MeshCounts;
+	counts.Reset();
+	ReserveScratch(counts, MeshISMs.Num());
+	counts.SetNumZeroed(MeshISMs.Num(), false);
+	for(const FInstancePlacement& placement : Placements)
+	{
+		counts[placement.MeshIdx]++;
+	}
 
-	// Root spline component
-	Spline = CreateDefaultSubobject<USplineComponent>(TEXT("Spline"));
-	Spline->EditorUnselectedSplineSegmentColor = FLinearColor(0, 1.0, 0.376262);
-	Spline->EditorTangentColor = FLinearColor(0.921, 0.299687, 0);
-	RootComponent = Spline;
+	// Bucket placements by picked mesh, so every ISM gets all of its instances in one batch
+	TArray<TArray<FTransform>>& buckets = Scratch.MeshTransforms;
+	if(buckets.Num() < MeshISMs.Num())
+	{
+		ReserveScratch(buckets, MeshISMs.Num());
+		buckets.SetNum(MeshISMs.Num(), false);
+	}
 
-	// Billboard for icon
-	static ConstructorHelpers::FObjectFinder<UTexture2D> ICN(TEXT("/Engine/EngineResources/Cursors/SplitterHorz.SplitterHorz"));	
-	Icn = CreateDefaultSubobject<UBillboardComponent>(TEXT("Icn"));
-	Icn->Sprite = ICN.Object;
-	Icn->bIsScreenSizeScaled = true;
-	Icn->ScreenSize = BILLBOARD_SPRITE_SIZE;
-	Icn->SetHiddenInGame(true);
-	Icn->SetupAttachment(RootComponent);
+	for(int i = 0; i < MeshISMs.Num(); i++)
+	{
+		buckets[i].Reset();
+		ReserveScratch(buckets[i], counts[i]);
+	}
+	
+	for(FInstancePlacement& placement : Placements)
+	{
+		placement.ComponentInstance = MeshISMs[placement.MeshIdx]->GetInstanceCount() + buckets[placement.MeshIdx].Add(placement.Transform);
+	}
+	
+	for(int i = 0; i < MeshISMs.Num(); i++)
+	{
+		if(buckets[i].Num() > 0)
+			MeshISMs[i]->AddInstances(buckets[i], false);
+	}
 }
 
-// Called when the game starts or when spawned
-void ASplinePlacementActor::BeginPlay()
+void ASplinePlacementActor::BuildMeshTable(const FMeshProfileInstance& MeshProfile, FSageScatterAliasTable& OutTable)
 {
-	Super::BeginPlay();
+	TArray<float, TInlineAllocator<8>> weights;
+	for(int i = 0; i < MeshProfile.GetNumMeshes(); i++)
+	{
+		weights.Add(MeshProfile.GetMeshWeight(i));
+	}
 	
+	OutTable.Build(weights);
 }
 
-void ASplinePlacementActor::RepopulateISMs()
+float ASplinePlacementActor::StepGapWalk(int32 InSeed, int ProfileIdx, const FMeshProfileInstance& MeshProfile,
+	const FSageScatterAliasTable& MeshTable, int32 InstanceIdx, int32 MeshIdx, int32& OutNextMeshIdx)
+{
+	// Consecutive instances are spaced by both their half lengths, so each keeps its own footprint. Never step less than
+	// a unit so negative gaps and jitter cannot stall the walk
+	OutNextMeshIdx = PickInstanceMesh(InSeed, ProfileIdx, InstanceIdx + 1, MeshTable);
+	FSageScatterRandom random(InSeed, ProfileIdx, InstanceIdx, RC_GAP);
+	return FMath::Max(GetScaledMeshHalfLength(MeshProfile, MeshIdx) + MeshProfile.Gap + GetScaledMeshHalfLength(MeshProfile, OutNextMeshIdx) + random.GetSigned(MeshProfile.Variation.GapJitter), 1.f);
+}
+
+int32 ASplinePlacementActor::PickInstanceMesh(int32 InSeed, int ProfileIdx, int InstanceIdx, const FSageScatterAliasTable& MeshTable)
+{
+	FSageScatterRandom random(InSeed, ProfileIdx, InstanceIdx, RC_MESH);
+	return MeshTable.Pick(random);
+}
+
+float ASplinePlacementActor::GetScaledMeshHalfLength(const FMeshProfileInstance& MeshProfile, int32 MeshIdx)
+{
+	// Scale mesh bounds with global scale
+	return MeshProfile.GetMesh(MeshIdx)->GetBounds().BoxExtent.X * MeshProfile.MeshData.Offset.GetScale3D().X;
+}
+
+float ASplinePlacementActor::GetMinScaledMeshHalfLength(const FMeshProfileInstance& MeshProfile)
 {
-	// Delete previous ISMs
-	GetComponents<UHierarchicalInstancedStaticMeshComponent>(ISMs);
-	for (int i = 0; i < ISMs.Num(); i++)
+	float minHalfLength = TNumericLimits<float>::Max();
+	for(int i = 0; i < MeshProfile.GetNumMeshes(); i++)
 	{
-		ISMs[i]->UnregisterComponent();
-		ISMs[i]->DestroyComponent();
+		if(MeshProfile.GetMeshWeight(i) > 0.f)
+			minHalfLength = FMath::Min(minHalfLength, GetScaledMeshHalfLength(MeshProfile, i));
 	}
-	
-	// Clear ISM array and create a new one
-	ISMs.Empty();
 
-	// Iterate and add each mesh profile as a new ISM
-	for(int i = 0; i < InstancedMeshes.Num(); i++)
+	return minHalfLength;
+}
+
+void ASplinePlacementActor::ApplyInstanceVariation(const FInstanceVariation& Variation, FSageScatterRandom& Random,
+	const FVector& Fwd, const FVector& Right, const FVector& Up, FVector& Location, FRotator& Rotation, FVector& Scale)
+{
+	// Always draw every value in the same order so changing one range does not reshuffle the others
+	const FVector locationJitter(Random.GetSigned(Variation.LocationJitter.X), Random.GetSigned(Variation.LocationJitter.Y), Random.GetSigned(Variation.LocationJitter.Z));
+	const FRotator rotationJitter(Random.GetSigned(Variation.RotationJitter.Pitch), Random.GetSigned(Variation.RotationJitter.Yaw), Random.GetSigned(Variation.RotationJitter.Roll));
+	const float scaleJitter = Random.GetInRange(Variation.MinScale, Variation.MaxScale);
+
+	Location += USageScatterUtils::CalculateOffsets(locationJitter, Fwd, Right, Up);
+	Rotation += rotationJitter;
+	Scale *= scaleJitter;
+}
+
+void ASplinePlacementActor::IndexPlacements(int ProfileIdx, const TArray<FInstancePlacement>& Placements,
+	const TArray<UHierarchicalInstancedStaticMeshComponent*>& MeshISMs, TConstArrayView<ULocalLightComponent*> Lights)
+{
+	if(!InstanceIndex.IsValidIndex(ProfileIdx) || Placements.Num() == 0)
+		return;
+
+	// Chunks cover disjoint ranges, so a chunk's placements go in as one block where its first one belongs
+	TArray<FPlacedInstance>& instances = InstanceIndex[ProfileIdx].Instances;
+	const int32 first = Algo::LowerBoundBy(instances, Placements[0].Distance, &FPlacedInstance::Distance);
+	instances.InsertDefaulted(first, Placements.Num());
+
+	const bool bHasLights = Lights.Num() == Placements.Num();
+	for(int i = 0; i < Placements.Num(); i++)
 	{
-		// Check if mesh is null first
-		if(InstancedMeshes[i].MeshData.Mesh == nullptr)
-			continue;
-		
-		UHierarchicalInstancedStaticMeshComponent* ism = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
-		ism->SetStaticMesh(InstancedMeshes[i].MeshData.Mesh);
-		ism->AttachToComponent(RootComponent, FAttachmentTransformRules::SnapToTargetIncludingScale);
-		ism->RegisterComponent();
-		ISMs.Add(ism);
+		const FInstancePlacement& placement = Placements[i];
+		FPlacedInstance& instance = instances[first + i];
+		instance.InstanceIdx = placement.InstanceIdx;
+		instance.Distance = placement.Distance;
+		instance.RelativeLocation = placement.Transform.GetLocation();
+		instance.MeshIdx = placement.MeshIdx;
+		instance.ISM = MeshISMs[placement.MeshIdx];
+		instance.ComponentInstance = placement.ComponentInstance;
+		instance.Light = bHasLights ? Lights[i] : nullptr;
 	}
 }
 
-void ASplinePlacementActor::PlaceInstancesAlongSpline()
+void ASplinePlacementActor::RemoveIndexedRange(float MinDistance, float MaxDistance)
 {
-	// First we clear all ISMs of their instances
-	for(int i = 0; i < ISMs.Num(); i++)
+	for(FProfileInstanceIndex& index : InstanceIndex)
 	{
-		ISMs[i]->ClearInstances();
+		const int32 first = Algo::LowerBoundBy(index.Instances, MinDistance, &FPlacedInstance::Distance);
+		const int32 last = Algo::LowerBoundBy(index.Instances, MaxDistance, &FPlacedInstance::Distance);
+		if(last > first)
+			index.Instances.RemoveAt(first, last - first, false);
 	}
+}
 
-	// Then we populate based on total length of spline
-	const float splineLength = Spline->GetSplineLength();
+bool ASplinePlacementActor::FindNearestInstance(int32 ProfileIdx, const FVector& WorldLocation, FPlacedInstance& OutInstance) const
+{
+	if(!InstanceIndex.IsValidIndex(ProfileIdx) || InstanceIndex[ProfileIdx].Instances.Num() == 0)
+		return false;
 
-	for(int i = 0; i < ISMs.Num(); i++)
+	const TArray<FPlacedInstance>& instances = InstanceIndex[ProfileIdx].Instances;
+
+	// Project the location onto the spline. Only the instances either side of that distance can be closest
+	const float key = Spline->FindInputKeyClosestToWorldLocation(WorldLocation);
+	const float distance = Spline->GetDistanceAlongSplineAtSplineInputKey(key);
+	const int32 next = Algo::LowerBoundBy(instances, distance, &FPlacedInstance::Distance);
+
+	// On closed loops the last and first instances are neighbours too
+	const FVector location = Spline->GetComponentTransform().InverseTransformPosition(WorldLocation);
+	const int32 candidates[] = { next - 1, next };
+	int32 nearest = INDEX_NONE;
+	double nearestDistSq = TNumericLimits<double>::Max();
+	for(int32 candidate : candidates)
 	{
-		// Error checking. If mesh does not exist then skip this one
-		if(InstancedMeshes[i].MeshData.Mesh == nullptr)
+		if(Spline->IsClosedLoop())
+			candidate = (candidate + instances.Num()) % instances.Num();
+		
+		if(!instances.IsValidIndex(candidate))
 			continue;
 
-		// Different placement types will generate different lists of transforms
-		TArray<FTransform> transforms;
-		switch (InstancedMeshes[i].PlacementType)
+		const double distSq = FVector::DistSquared(instances[candidate].RelativeLocation, location);
+		if(distSq < nearestDistSq)
 		{
-		case EInstancePlacementType::IPT_GAP:
-			if(CalculateTransformsAtRegularDistances(splineLength, InstancedMeshes[i], transforms))
-				break;
-
-		case EInstancePlacementType::IPT_POINT:
-			if(CalculateTransformsAtSplinePoints(InstancedMeshes[i], transforms))
-			 	break;
+			nearest = candidate;
+			nearestDistSq = distSq;
 		}
-		
-		// Add instances to ISM
-		ISMs[i]->AddInstances(transforms,false);
-		CreateLCs(i);
-		UpdateLCs(i);
 	}
+
+	if(nearest == INDEX_NONE)
+		return false;
+
+	OutInstance = instances[nearest];
+	return true;
 }
 
-bool ASplinePlacementActor::CalculateTransformsAtRegularDistances(float SplineLength, FMeshProfileInstance MeshProfile,
-	TArray<FTransform> &OutTransforms)
+void ASplinePlacementActor::GetInstancesInDistanceRange(int32 ProfileIdx, float MinDistance, float MaxDistance,
+	TArray<FPlacedInstance>& OutInstances) const
 {
-	FBoxSphereBounds meshBounds = MeshProfile.MeshData.Mesh->GetBounds();
+	OutInstances.Reset();
+	if(!InstanceIndex.IsValidIndex(ProfileIdx))
+		return;
 
-	// Scale mesh bounds with global scale
-	meshBounds.BoxExtent = meshBounds.BoxExtent*MeshProfile.MeshData.Offset.GetScale3D();
+	const TArray<FPlacedInstance>& instances = InstanceIndex[ProfileIdx].Instances;
+	const int32 first = Algo::LowerBoundBy(instances, MinDistance, &FPlacedInstance::Distance);
+	const int32 last = Algo::UpperBoundBy(instances, MaxDistance, &FPlacedInstance::Distance);
+	if(last > first)
+		OutInstances.Append(instances.GetData() + first, last - first);
+}
 
-	// If the asset is larger than the current spline length, we will return without placing anything
-	if(meshBounds.BoxExtent.X*2 > SplineLength)
+bool ASplinePlacementActor::FindInstance(int32 ProfileIdx, int32 InstanceIdx, FPlacedInstance& OutInstance) const
+{
+	if(!InstanceIndex.IsValidIndex(ProfileIdx))
 		return false;
 
-	const int steps = (SplineLength-MeshProfile.StartOffset) / FMath::Min<float>(MeshProfile.Gap+meshBounds.BoxExtent.X*2, SplineLength-MeshProfile.StartOffset);
-
-	// Iterate with number of steps to get transform values for that many instances
-	for(int i = 0; i <= steps; i++)
-	{
-		float dist = i * (MeshProfile.Gap + meshBounds.BoxExtent.X * 2) + MeshProfile.StartOffset;
-		FTransform transform = GetTransformAtDistanceAlongSpline(dist);
-
-		// Cache fwd, up, right vectors
-		FVector fwd, right, up;
-		GetDirectionVectorsAtDistanceAlongSpline(dist, fwd, right, up);
-		
-		// Calculate location, rotation, and scale
-		FVector location = transform.GetLocation() + USageScatterUtils::CalculateOffsets(MeshProfile.MeshData.Offset.GetLocation(), fwd, right, up);
-		FRotator rotation =  transform.GetRotation().Rotator() + MeshProfile.MeshData.Offset.GetRotation().Rotator();
-		FVector scale = transform.GetScale3D() * MeshProfile.MeshData.Offset.GetScale3D();
-
-		OutTransforms.Add(FTransform(rotation, location, scale));
-	}
+	const TArray<FPlacedInstance>& instances = InstanceIndex[ProfileIdx].Instances;
+	const int32 found = Algo::LowerBoundBy(instances, InstanceIdx, &FPlacedInstance::InstanceIdx);
+	if(!instances.IsValidIndex(found) || instances[found].InstanceIdx != InstanceIdx)
+		return false;
 
+	OutInstance = instances[found];
 	return true;
 }
 
-bool ASplinePlacementActor::CalculateTransformsAtSplinePoints(FMeshProfileInstance MeshProfile,
-	TArray<FTransform>& OutTransforms)
+ULocalLightComponent* ASplinePlacementActor::GetInstanceLight(int32 ProfileIdx, int32 InstanceIdx) const
 {
-	FBoxSphereBounds meshBounds = MeshProfile.MeshData.Mesh->GetBounds();
-
-	// Scale mesh bounds with global scale
-	meshBounds.BoxExtent = meshBounds.BoxExtent*MeshProfile.MeshData.Offset.GetScale3D();
+	FPlacedInstance instance;
+	return FindInstance(ProfileIdx, InstanceIdx, instance) ? instance.Light : nullptr;
+}
 
-	int numPoints = Spline->GetNumberOfSplinePoints();
-	
-	// Iterate with number of spline points to generate transforms at those locations
-	for(int i = 0; i < numPoints; i++)
+void ASplinePlacementActor::ApplyInstanceCustomData(int32 InSeed, int ProfileIdx, const FMeshProfileInstance& MeshProfile,
+	const TArray<UHierarchicalInstancedStaticMeshComponent*>& MeshISMs, const TArray<FInstancePlacement>& Placements)
+{
+	const TArray<FVector2D>& ranges = MeshProfile.Variation.CustomDataRanges;
+	for(UHierarchicalInstancedStaticMeshComponent* ism : MeshISMs)
 	{
-		float dist = Spline->GetDistanceAlongSplineAtSplinePoint(i);
-		FTransform transform = GetTransformAtDistanceAlongSpline(dist);
+		if(ism != nullptr)
+			ism->SetNumCustomDataFloats(ranges.Num());
+	}
+	
+	if(ranges.Num() == 0)
+		return;
 
-		// Cache fwd, up, right vectors
-		FVector fwd, right, up;
-		GetDirectionVectorsAtDistanceAlongSpline(dist, fwd, right, up);
+	// Custom data is keyed on the profile instance index, so it does not change when the picked mesh does
+	TArray<float>& customData = Scratch.CustomData;
+	ReserveScratch(customData, ranges.Num());
+	customData.SetNumUninitialized(ranges.Num(), false);
+	for(const FInstancePlacement& placement : Placements)
+	{
+		FSageScatterRandom random(InSeed, ProfileIdx, placement.InstanceIdx, RC_CUSTOM_DATA);
+		for(int j = 0; j < ranges.Num(); j++)
+		{
+			customData[j] = random.GetInRange(ranges[j].X, ranges[j].Y);
+		}
 		
-		FVector location = Spline->GetLocationAtSplinePoint(i, ESplineCoordinateSpace::Local) + USageScatterUtils::CalculateOffsets(MeshProfile.MeshData.Offset.GetLocation(), fwd, right, up);
-		FRotator rotation = Spline->GetRotationAtSplinePoint(i, ESplineCoordinateSpace::Local) + MeshProfile.MeshData.Offset.GetRotation().Rotator();
-		FVector scale = Spline->GetScaleAtSplinePoint(i) * MeshProfile.MeshData.Offset.GetScale3D();
-
-		OutTransforms.Add(FTransform(rotation, location, scale));
+		MeshISMs[placement.MeshIdx]->SetCustomData(placement.ComponentInstance, customData, false);
 	}
 
-	return true;
+	for(UHierarchicalInstancedStaticMeshComponent* ism : MeshISMs)
+	{
+		if(ism != nullptr)
+			ism->MarkRenderStateDirty();
+	}
 }
 
 void ASplinePlacementActor::RecalculateSplineMeshes()
@@ -203,14 +1168,17 @@ void ASplinePlacementActor::RecalculateSplineMeshes()
 		}
 	}
 
-	GetComponents<USplineMeshComponent>(SMCs);
+	// Undo and load destroy all generated components first, so our array is all there is
+	SMCs.RemoveAll([](const USplineMeshComponent* smc) { return !IsValid(smc); });
+	
 	// If there are less Spline mesh components than needed, we need to create more. If there are more, we need to destroy
 	if(SMCs.Num() < requiredSMCs)
 	{
 		for(int i = SMCs.Num(); i < requiredSMCs; i++)
 		{
-			USplineMeshComponent* smc = NewObject<USplineMeshComponent>(this);
-			smc->AttachToComponent(RootComponent, FAttachmentTransformRules::SnapToTargetIncludingScale);
+			// Collision is only turned on per segment once its mesh and shape are set
+			USplineMeshComponent* smc = NewGeneratedComponent<USplineMeshComponent>();
+			smc->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 			smc->RegisterComponent();
 			SMCs.Add(smc);
 		}
@@ -225,15 +1193,51 @@ void ASplinePlacementActor::RecalculateSplineMeshes()
 		}
 
 		// Remove the destroyed components from the array
-		SMCs.RemoveAt(requiredSMCs, SMCs.Num() - requiredSMCs);
+		SMCs.RemoveAt(requiredSMCs, SMCs.Num() - requiredSMCs, false);
 	}
 }
 
 void ASplinePlacementActor::PlaceSplineMeshComponentsAlongSpline()
 {
-	int currentIdx = 0;
-	// Place SMCs based on mesh data
-	for (FMeshProfileSpline splineMeshProfile : SplineMeshes)
+	// Recalculating made exactly one SMC per segment
+	TArray<FSplineMeshSegment>& segments = Scratch.Segments;
+	segments.Reset();
+	ReserveScratch(segments, SMCs.Num());
+	CalculateSplineMeshSegments(Spline, GetActorLocation(), SplineMeshes, 0.f, TNumericLimits<float>::Max(), segments);
+
+	// Assign mesh and use SMC (since we are fitting a dynamic 2d array into a 1d array). Collision goes off before the
+	// mesh and shape change and back on after, so no physics body is built for a segment without collision, and one
+	// with it builds its body once, for its final shape
+	for(int i = 0; i < FMath::Min(segments.Num(), SMCs.Num()); i++)
+	{
+		SMCs[i]->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		SMCs[i]->SetStaticMesh(segments[i].Mesh);
+		SMCs[i]->SetStartAndEnd(segments[i].StartLocation, segments[i].StartTangent, segments[i].EndLocation, segments[i].EndTangent);
+		
+		if(segments[i].CollisionMode == EPlacementCollisionMode::PCM_PER_INSTANCE)
+			SMCs[i]->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+	}
+
+	const float splineLength = Spline->GetSplineLength();
+	ResizeCollisionProxies(SplineCollisionProxies, SplineMeshes.Num());
+	ReserveScratch(Scratch.SplineProxyGeometry, SplineMeshes.Num());
+	Scratch.SplineProxyGeometry.SetNum(SplineMeshes.Num());
+	for(int i = 0; i < SplineMeshes.Num(); i++)
+	{
+		const FMeshProfileSpline& splineMeshProfile = SplineMeshes[i];
+		float startDistance = 0.f, endDistance = 0.f;
+		if(splineMeshProfile.MeshData.Mesh != nullptr)
+			GetSplineMeshProfileRange(splineMeshProfile, splineLength, startDistance, endDistance);
+		
+		UpdateCollisionProxy(SplineCollisionProxies[i], Scratch.SplineProxyGeometry[i], splineMeshProfile.MeshData, GetScaledMeshBox(splineMeshProfile.MeshData, splineMeshProfile.MeshData.Mesh), startDistance, endDistance);
+	}
+}
+
+void ASplinePlacementActor::CalculateSplineMeshSegments(const USplineComponent* InSpline, const FVector& ActorLocation, const TArray<FMeshProfileSpline>& Profiles, float MinDistance,
+	float MaxDistance, TArray<FSplineMeshSegment>& OutSegments)
+{
+	// Calculate segments based on mesh data
+	for (const FMeshProfileSpline& splineMeshProfile : Profiles)
 	{
 		// If the mesh is not set, skip this profile
 		if(splineMeshProfile.MeshData.Mesh == nullptr)
@@ -241,7 +1245,7 @@ void ASplinePlacementActor::PlaceSplineMeshComponentsAlongSpline()
 		
 		// Get extents of total mesh and calculate number of steps required to place mesh along spline
 		// Subtract end and start distance from it
-		const float rawSplineLength = Spline->GetSplineLength();
+		const float rawSplineLength = InSpline->GetSplineLength();
 		const float finalSplineLength = rawSplineLength * splineMeshProfile.EndOffset - rawSplineLength * splineMeshProfile.StartOffset;
 
 		const FVector extent = splineMeshProfile.MeshData.Mesh->GetBounds().BoxExtent * splineMeshProfile.MeshData.Offset.GetScale3D();
@@ -252,64 +1256,270 @@ void ASplinePlacementActor::PlaceSplineMeshComponentsAlongSpline()
 			// Single step should be the extent of the mesh, or the length of the spline if that is smaller
 			const float singleStep = FMath::Min<float>(extent.X * 2 * splineMeshProfile.RelaxMultiplier, finalSplineLength);
 			const int steps = finalSplineLength / singleStep;
+
+			// Start just before the first step in range, the check below settles rounding at the boundary
+			const float baseDist = rawSplineLength * splineMeshProfile.StartOffset;
+			const int firstStep = MinDistance > baseDist ? FMath::Max(FMath::FloorToInt((MinDistance - baseDist) / singleStep) - 1, 0) : 0;
 			
-			for(int i = 0; i < steps; i++)
+			for(int i = firstStep; i < steps; i++)
 			{
-				const float startDist = i * singleStep + rawSplineLength * splineMeshProfile.StartOffset;
-				const float endDist = (i + 1) * singleStep + rawSplineLength * splineMeshProfile.StartOffset;
+				const float startDist = i * singleStep + baseDist;
+				const float endDist = (i + 1) * singleStep + baseDist;
+				if(startDist >= MaxDistance)
+					break;
+				if(startDist < MinDistance)
+					continue;
 				
 				// For spline meshes, there is a start and end transform
-				FTransform startTransform = Spline->GetTransformAtDistanceAlongSpline(startDist, ESplineCoordinateSpace::Local, true);
-				FTransform endTransform = Spline->GetTransformAtDistanceAlongSpline(endDist, ESplineCoordinateSpace::Local, true);
+				FTransform startTransform = InSpline->GetTransformAtDistanceAlongSpline(startDist, ESplineCoordinateSpace::Local, true);
+				FTransform endTransform = InSpline->GetTransformAtDistanceAlongSpline(endDist, ESplineCoordinateSpace::Local, true);
 				
 				// Cache fwd, up, right vectors
 				FVector startFwd, startRight, startUp;
-				GetDirectionVectorsAtDistanceAlongSpline(startDist, startFwd, startRight, startUp);
+				GetDirectionVectorsAtDistanceAlongSpline(InSpline, startDist, startFwd, startRight, startUp);
 				FVector endFwd, endRight, endUp;
-				GetDirectionVectorsAtDistanceAlongSpline(endDist, endFwd, endRight, endUp);
+				GetDirectionVectorsAtDistanceAlongSpline(InSpline, endDist, endFwd, endRight, endUp);
 
 				// Calculate locations
-				FVector startLocation = GetActorLocation() + startTransform.GetLocation() + USageScatterUtils::CalculateOffsets(splineMeshProfile.MeshData.Offset.GetLocation(), startFwd, startRight, startUp);
-				FVector startTangent = Spline->GetTangentAtDistanceAlongSpline(startDist, ESplineCoordinateSpace::Local).GetClampedToMaxSize(singleStep);
-				FVector endLocation = GetActorLocation() + endTransform.GetLocation() + USageScatterUtils::CalculateOffsets(splineMeshProfile.MeshData.Offset.GetLocation(), endFwd, endRight, endUp);
-				FVector endTangent = Spline->GetTangentAtDistanceAlongSpline(endDist, ESplineCoordinateSpace::Local).GetClampedToMaxSize(singleStep);
+				FVector startLocation = ActorLocation + startTransform.GetLocation() + USageScatterUtils::CalculateOffsets(splineMeshProfile.MeshData.Offset.GetLocation(), startFwd, startRight, startUp);
+				FVector startTangent = InSpline->GetTangentAtDistanceAlongSpline(startDist, ESplineCoordinateSpace::Local).GetClampedToMaxSize(singleStep);
+				FVector endLocation = ActorLocation + endTransform.GetLocation() + USageScatterUtils::CalculateOffsets(splineMeshProfile.MeshData.Offset.GetLocation(), endFwd, endRight, endUp);
+				FVector endTangent = InSpline->GetTangentAtDistanceAlongSpline(endDist, ESplineCoordinateSpace::Local).GetClampedToMaxSize(singleStep);
 				
-				// Assign mesh and use SMC
-				SMCs[currentIdx]->SetStaticMesh(splineMeshProfile.MeshData.Mesh);
-				SMCs[currentIdx]->SetStartAndEnd(startLocation, startTangent, endLocation, endTangent);
-
-				// Increment index to use (since we are fitting a dynamic 2d array into a 1d array)
-				currentIdx++;
+				OutSegments.Add({splineMeshProfile.MeshData.Mesh, startDist, startLocation, startTangent, endLocation, endTangent, splineMeshProfile.MeshData.CollisionMode});
 			}
 		}
 		else if(splineMeshProfile.PlacementType == ESplinePlacementType::SPT_SINGLE)
 		{
 			const float startDist = splineMeshProfile.StartDistance;
 			const float endDist = startDist + splineMeshProfile.MeshLength;
+			if(startDist < MinDistance || startDist >= MaxDistance)
+				continue;
 
 			// Cache fwd, up, right vectors
 			FVector startFwd, startRight, startUp;
-			GetDirectionVectorsAtDistanceAlongSpline(startDist, startFwd, startRight, startUp);
+			GetDirectionVectorsAtDistanceAlongSpline(InSpline, startDist, startFwd, startRight, startUp);
 			FVector endFwd, endRight, endUp;
-			GetDirectionVectorsAtDistanceAlongSpline(endDist, endFwd, endRight, endUp);
+			GetDirectionVectorsAtDistanceAlongSpline(InSpline, endDist, endFwd, endRight, endUp);
 
 			// Calculate locations
-			FVector startLocation = GetActorLocation() + Spline->GetLocationAtDistanceAlongSpline(startDist, ESplineCoordinateSpace::Local) + USageScatterUtils::CalculateOffsets(splineMeshProfile.MeshData.Offset.GetLocation(), startFwd, startRight, startUp);
-			FVector startTangent = Spline->GetTangentAtDistanceAlongSpline(startDist, ESplineCoordinateSpace::Local).GetClampedToMaxSize(splineMeshProfile.MeshLength);
-			FVector endLocation = GetActorLocation() + Spline->GetLocationAtDistanceAlongSpline(endDist, ESplineCoordinateSpace::Local) + USageScatterUtils::CalculateOffsets(splineMeshProfile.MeshData.Offset.GetLocation(), endFwd, endRight, endUp);
-			FVector endTangent = Spline->GetTangentAtDistanceAlongSpline(endDist, ESplineCoordinateSpace::Local).GetClampedToMaxSize(splineMeshProfile.MeshLength);
-
-			// Assign mesh and use SMC
-			SMCs[currentIdx]->SetStaticMesh(splineMeshProfile.MeshData.Mesh);
-			SMCs[currentIdx]->SetStartAndEnd(startLocation, startTangent, endLocation, endTangent);
+			FVector startLocation = ActorLocation + InSpline->GetLocationAtDistanceAlongSpline(startDist, ESplineCoordinateSpace::Local) + USageScatterUtils::CalculateOffsets(splineMeshProfile.MeshData.Offset.GetLocation(), startFwd, startRight, startUp);
+			FVector startTangent = InSpline->GetTangentAtDistanceAlongSpline(startDist, ESplineCoordinateSpace::Local).GetClampedToMaxSize(splineMeshProfile.MeshLength);
+			FVector endLocation = ActorLocation + InSpline->GetLocationAtDistanceAlongSpline(endDist, ESplineCoordinateSpace::Local) + USageScatterUtils::CalculateOffsets(splineMeshProfile.MeshData.Offset.GetLocation(), endFwd, endRight, endUp);
+			FVector endTangent = InSpline->GetTangentAtDistanceAlongSpline(endDist, ESplineCoordinateSpace::Local).GetClampedToMaxSize(splineMeshProfile.MeshLength);
+
+			OutSegments.Add({splineMeshProfile.MeshData.Mesh, startDist, startLocation, startTangent, endLocation, endTangent, splineMeshProfile.MeshData.CollisionMode});
+		}
+	}
+}
+
+ECollisionEnabled::Type ASplinePlacementActor::GetGeneratedCollision(const FMeshProfile& MeshData)
+{
+	return MeshData.CollisionMode == EPlacementCollisionMode::PCM_PER_INSTANCE ? ECollisionEnabled::QueryAndPhysics : ECollisionEnabled::NoCollision;
+}
+
+FBox ASplinePlacementActor::GetScaledMeshBox(const FMeshProfile& MeshData, const UStaticMesh* Mesh)
+{
+	if(Mesh == nullptr)
+		return FBox(ForceInit);
+	
+	const FBox box = Mesh->GetBoundingBox();
+	return FBox(box.Min * MeshData.Offset.GetScale3D(), box.Max * MeshData.Offset.GetScale3D());
+}
+
+FBox ASplinePlacementActor::GetScaledMeshBox(const FMeshProfileInstance& MeshProfile)
+{
+	FBox box(ForceInit);
+	for(int i = 0; i < MeshProfile.GetNumMeshes(); i++)
+	{
+		if(MeshProfile.GetMeshWeight(i) > 0.f)
+			box += GetScaledMeshBox(MeshProfile.MeshData, MeshProfile.GetMesh(i));
+	}
+
+	return box;
+}
+
+void ASplinePlacementActor::GetSplineMeshProfileRange(const FMeshProfileSpline& MeshProfile, float SplineLength,
+	float& OutStartDistance, float& OutEndDistance)
+{
+	if(MeshProfile.PlacementType == ESplinePlacementType::SPT_SINGLE)
+	{
+		OutStartDistance = MeshProfile.StartDistance;
+		OutEndDistance = MeshProfile.StartDistance + MeshProfile.MeshLength;
+	}
+	else
+	{
+		OutStartDistance = SplineLength * MeshProfile.StartOffset;
+		OutEndDistance = SplineLength * MeshProfile.EndOffset;
+	}
+}
+
+void ASplinePlacementActor::CalculateCollisionProxy(const USplineComponent* InSpline, const FMeshProfile& MeshData, const FBox& MeshBox, float StartDistance,
+	float EndDistance, FCollisionProxySamples& Samples, FKAggregateGeom& OutGeometry)
+{
+	OutGeometry.BoxElems.Reset();
+	if(!MeshBox.IsValid || EndDistance <= StartDistance)
+	{
+		OutGeometry.ConvexElems.Reset();
+		return;
+	}
+
+	// Sample the offset spline finely enough that the tolerance check below sees its bends
+	const float tolerance = FMath::Max(MeshData.CollisionTolerance, 1.f);
+	const int numSamples = FMath::CeilToInt((EndDistance - StartDistance) / FMath::Max(tolerance * 2.f, 10.f)) + 1;
+	TArray<FVector>& locations = Samples.Locations;
+	TArray<FVector>& rights = Samples.Rights;
+	TArray<FVector>& ups = Samples.Ups;
+	locations.SetNumUninitialized(numSamples, false);
+	rights.SetNumUninitialized(numSamples, false);
+	ups.SetNumUninitialized(numSamples, false);
+	
+	for(int i = 0; i < numSamples; i++)
+	{
+		const float dist = FMath::Lerp(StartDistance, EndDistance, static_cast<float>(i) / (numSamples - 1));
+		FVector fwd;
+		GetDirectionVectorsAtDistanceAlongSpline(InSpline, dist, fwd, rights[i], ups[i]);
+		locations[i] = InSpline->GetLocationAtDistanceAlongSpline(dist, ESplineCoordinateSpace::Local) + USageScatterUtils::CalculateOffsets(MeshData.Offset.GetLocation(), fwd, rights[i], ups[i]);
+	}
+
+	// Split pieces at the sample furthest from their chord until every sample is within the tolerance of its piece's
+	// chord. Each split only looks at the samples of one piece, so long straight stretches cost n log n rather than n^2
+	TArray<bool>& pieceEnds = Samples.PieceEnds;
+	pieceEnds.Reset();
+	pieceEnds.SetNumZeroed(numSamples, false);
+	pieceEnds[0] = true;
+	pieceEnds[numSamples - 1] = true;
+
+	TArray<FIntPoint>& openRanges = Samples.OpenRanges;
+	openRanges.Reset();
+	openRanges.Emplace(0, numSamples - 1);
+	while(openRanges.Num() > 0)
+	{
+		const FIntPoint range = openRanges.Pop(false);
+		float furthestDistance = tolerance;
+		int furthest = INDEX_NONE;
+		for(int i = range.X + 1; i < range.Y; i++)
+		{
+			const float distance = FMath::PointDistToSegment(locations[i], locations[range.X], locations[range.Y]);
+			if(distance > furthestDistance)
+			{
+				furthestDistance = distance;
+				furthest = i;
+			}
+		}
+
+		if(furthest != INDEX_NONE)
+		{
+			pieceEnds[furthest] = true;
+			openRanges.Emplace(range.X, furthest);
+			openRanges.Emplace(furthest, range.Y);
+		}
+	}
+
+	int first = 0;
+	int32 numConvex = 0;
+	for(int last = 1; last < numSamples; last++)
+	{
+		if(!pieceEnds[last])
+			continue;
+
+		const FVector chord = locations[last] - locations[first];
+		if(MeshData.ProxyShape == ECollisionProxyShape::CPS_CONVEX)
+		{
+			// The mesh cross section at both ends, so the hull follows twist and roll. Pieces left from the last fit are
+			// overwritten, so their vertex memory is reused
+			FKConvexElem& convex = numConvex < OutGeometry.ConvexElems.Num() ? OutGeometry.ConvexElems[numConvex] : OutGeometry.ConvexElems.AddDefaulted_GetRef();
+			convex.VertexData.Reset();
+			numConvex++;
+			for(const int end : {first, last})
+			{
+				for(const float y : {MeshBox.Min.Y, MeshBox.Max.Y})
+				{
+					for(const float z : {MeshBox.Min.Z, MeshBox.Max.Z})
+					{
+						convex.VertexData.Add(locations[end] + rights[end] * y + ups[end] * z);
+					}
+				}
+			}
+			
+			convex.UpdateElemBox();
+		}
+		else
+		{
+			// A box along the chord, oriented by the average up vector of its ends
+			const FRotator rotation = FRotationMatrix::MakeFromXZ(chord, ups[first] + ups[last]).Rotator();
+			const FVector crossSectionCenter(0.f, MeshBox.GetCenter().Y, MeshBox.GetCenter().Z);
 			
-			// Increment index to use (since we are fitting a dynamic 2d array into a 1d array)
-			currentIdx++;
+			FKBoxElem& box = OutGeometry.BoxElems.AddDefaulted_GetRef();
+			box.X = chord.Size();
+			box.Y = MeshBox.GetSize().Y;
+			box.Z = MeshBox.GetSize().Z;
+			box.Rotation = rotation;
+			box.Center = (locations[first] + locations[last]) * 0.5f + rotation.RotateVector(crossSectionCenter);
 		}
+
+		first = last;
+	}
+
+	OutGeometry.ConvexElems.SetNum(numConvex, false);
+}
+
+void ASplinePlacementActor::ResizeCollisionProxies(TArray<USplineCollisionComponent*>& Proxies, int32 NumProfiles)
+{
+	for(int i = NumProfiles; i < Proxies.Num(); i++)
+	{
+		DestroyCollisionProxy(Proxies[i]);
+	}
+
+	Proxies.SetNumZeroed(NumProfiles, false);
+}
+
+void ASplinePlacementActor::DestroyCollisionProxy(USplineCollisionComponent*& Proxy)
+{
+	if(Proxy != nullptr)
+	{
+		Proxy->UnregisterComponent();
+		Proxy->DestroyComponent();
+		Proxy = nullptr;
+	}
+}
+
+void ASplinePlacementActor::UpdateCollisionProxy(USplineCollisionComponent*& Proxy, FKAggregateGeom& Geometry,
+	const FMeshProfile& MeshData, const FBox& MeshBox, float StartDistance, float EndDistance)
+{
+	if(MeshData.CollisionMode != EPlacementCollisionMode::PCM_MERGED)
+	{
+		DestroyCollisionProxy(Proxy);
+		return;
+	}
+	
+	FCollisionProxySamples& samples = Scratch.ProxySamples;
+	const int32 samplesMax = samples.Locations.Max();
+	const int32 rangesMax = samples.OpenRanges.Max();
+	const int32 boxesMax = Geometry.BoxElems.Max();
+	const int32 convexMax = Geometry.ConvexElems.Max();
+	CalculateCollisionProxy(Spline, MeshData, MeshBox, StartDistance, EndDistance, samples, Geometry);
+	CountScratchGrowth(samples.Locations, samplesMax);
+	CountScratchGrowth(samples.OpenRanges, rangesMax);
+	CountScratchGrowth(Geometry.BoxElems, boxesMax);
+	CountScratchGrowth(Geometry.ConvexElems, convexMax);
+
+	if(Geometry.GetElementCount() == 0)
+	{
+		DestroyCollisionProxy(Proxy);
+		return;
+	}
+
+	if(Proxy == nullptr)
+	{
+		Proxy = NewGeneratedComponent<USplineCollisionComponent>();
+		Proxy->RegisterComponent();
 	}
+	
+	Proxy->SetCollisionGeometry(Geometry);
 }
 
-void ASplinePlacementActor::CreateLCs(const int idx)
+void ASplinePlacementActor::CreateLCs(const int idx, const int NumInstances)
 {
 	// If the light doesnt need to be added, we skip it
 	if(!InstancedMeshes[idx].bActivateLight || bForceUnloadLights)
@@ -329,71 +1539,76 @@ void ASplinePlacementActor::CreateLCs(const int idx)
 
 	bForceUnloadLights = false;
 	
-	if(InstancedMeshes[idx].PLCs.Num() != ISMs[idx]->GetInstanceCount())
+	if(InstancedMeshes[idx].PLCs.Num() != NumInstances)
 	{
-		if(InstancedMeshes[idx].PLCs.Num() > ISMs[idx]->GetInstanceCount())
+		if(InstancedMeshes[idx].PLCs.Num() > NumInstances)
 		{
-			for(int i = InstancedMeshes[idx].PLCs.Num()-1; i >= ISMs[idx]->GetInstanceCount(); i--)
+			for(int i = InstancedMeshes[idx].PLCs.Num()-1; i >= NumInstances; i--)
 			{
 				ULocalLightComponent* ll = InstancedMeshes[idx].PLCs.Pop();
 				ll->UnregisterComponent();
 				ll->DestroyComponent();
 			}
 		}
-		else if(InstancedMeshes[idx].PLCs.Num() < ISMs[idx]->GetInstanceCount())
+		else if(InstancedMeshes[idx].PLCs.Num() < NumInstances)
 		{
-			for(int i = InstancedMeshes[idx].PLCs.Num(); i < ISMs[idx]->GetInstanceCount(); i++)
+			for(int i = InstancedMeshes[idx].PLCs.Num(); i < NumInstances; i++)
 			{
-				if(InstancedMeshes[idx].LightData.Type == ELightType::LT_POINT)
-				{
-					UPointLightComponent* plc = NewObject<UPointLightComponent>(this);
-					plc->AttachToComponent(RootComponent, FAttachmentTransformRules::SnapToTargetIncludingScale);
-					plc->RegisterComponent();
-					plc->SetIntensityUnits(ELightUnits::Candelas);
-					InstancedMeshes[idx].PLCs.Add(plc);
-				}
-				else
-				{
-					USpotLightComponent* slc = NewObject<USpotLightComponent>(this);
-					slc->AttachToComponent(RootComponent, FAttachmentTransformRules::SnapToTargetIncludingScale);
-					slc->RegisterComponent();
-					slc->SetIntensityUnits(ELightUnits::Candelas);
-					InstancedMeshes[idx].PLCs.Add(slc);
-				}
+				InstancedMeshes[idx].PLCs.Add(CreateLC(InstancedMeshes[idx].LightData));
 			}
 		}
 	}
 }
 
-void ASplinePlacementActor::UpdateLCs(const int idx)
+ULocalLightComponent* ASplinePlacementActor::CreateLC(const FLightProfile& LightProfile)
+{
+	ULocalLightComponent* ll;
+	if(LightProfile.Type == ELightType::LT_POINT)
+	{
+		ll = NewGeneratedComponent<UPointLightComponent>();
+	}
+	else
+	{
+		ll = NewGeneratedComponent<USpotLightComponent>();
+	}
+	
+	ll->RegisterComponent();
+	ll->SetIntensityUnits(ELightUnits::Candelas);
+	return ll;
+}
+
+void ASplinePlacementActor::UpdateLCs(const int idx, const TArray<FInstancePlacement>& Placements)
 {
 	// If the light doesnt need to be added, we skip it
 	if(!InstancedMeshes[idx].bActivateLight)
 		return;
 	
-	for(int i = 0; i < ISMs[idx]->GetInstanceCount(); i++)
+	for(int i = 0; i < Placements.Num(); i++)
 	{
-		FTransform transform;
-		ISMs[idx]->GetInstanceTransform(i, transform);
-		transform.SetLocation(transform.GetLocation() + USageScatterUtils::CalculateOffsets(InstancedMeshes[idx].LightData.LocationOffset, transform.GetUnitAxis(EAxis::X), transform.GetUnitAxis(EAxis::Y), transform.GetUnitAxis(EAxis::Z)));
-		transform.SetRotation((USageScatterUtils::MakeRotatorFromAxes(transform.GetUnitAxis(EAxis::X), transform.GetUnitAxis(EAxis::Y), transform.GetUnitAxis(EAxis::Z)) + InstancedMeshes[idx].LightData.RotationOffset).Quaternion());
-		
 		// Set data on point light component
-		InstancedMeshes[idx].PLCs[i]->SetRelativeTransform(transform);
+		InstancedMeshes[idx].PLCs[i]->SetRelativeTransform(CalculateLightTransform(InstancedMeshes[idx].LightData, Placements[i].Transform));
 		UpdateLightPropertiesFromProfile(InstancedMeshes[idx].LightData, InstancedMeshes[idx].PLCs[i]);
 	}
 }
 
-FTransform ASplinePlacementActor::GetTransformAtDistanceAlongSpline(float Distance)
+FTransform ASplinePlacementActor::CalculateLightTransform(const FLightProfile& LightProfile, const FTransform& InstanceTransform)
+{
+	FTransform transform = InstanceTransform;
+	transform.SetLocation(transform.GetLocation() + USageScatterUtils::CalculateOffsets(LightProfile.LocationOffset, transform.GetUnitAxis(EAxis::X), transform.GetUnitAxis(EAxis::Y), transform.GetUnitAxis(EAxis::Z)));
+	transform.SetRotation((USageScatterUtils::MakeRotatorFromAxes(transform.GetUnitAxis(EAxis::X), transform.GetUnitAxis(EAxis::Y), transform.GetUnitAxis(EAxis::Z)) + LightProfile.RotationOffset).Quaternion());
+	return transform;
+}
+
+FTransform ASplinePlacementActor::GetTransformAtDistanceAlongSpline(const USplineComponent* InSpline, float Distance)
 {
-	return Spline->GetTransformAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::Local, true);
+	return InSpline->GetTransformAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::Local, true);
 }
 
-void ASplinePlacementActor::GetDirectionVectorsAtDistanceAlongSpline(float Distance, FVector& Fwd, FVector& Right, FVector& Up)
+void ASplinePlacementActor::GetDirectionVectorsAtDistanceAlongSpline(const USplineComponent* InSpline, float Distance, FVector& Fwd, FVector& Right, FVector& Up)
 {
-	Fwd = Spline->GetDirectionAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::Local);
-	Right = Spline->GetRightVectorAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::Local);
-	Up = Spline->GetUpVectorAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::Local);
+	Fwd = InSpline->GetDirectionAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::Local);
+	Right = InSpline->GetRightVectorAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::Local);
+	Up = InSpline->GetUpVectorAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::Local);
 }
 
 void ASplinePlacementActor::UpdateLightPropertiesFromProfile(const FLightProfile& LightProfile,
@@ -431,6 +1646,27 @@ void ASplinePlacementActor::UpdateLightPropertiesFromProfile(const FLightProfile
 void ASplinePlacementActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+
+	if(Chunks.Num() == 0)
+		return;
+
+	// Apply finished chunk builds. Component creation has to happen on the game thread
+	for(int i = ChunkBuilds.Num() - 1; i >= 0; i--)
+	{
+		if(ChunkBuilds[i].IsReady())
+		{
+			FChunkBuildResult result = ChunkBuilds[i].Consume();
+			ChunkBuilds.RemoveAtSwap(i);
+			FinishChunkBuild(result);
+		}
+	}
+
+	StreamingUpdateTimer -= DeltaTime;
+	if(StreamingUpdateTimer <= 0.f)
+	{
+		StreamingUpdateTimer = StreamingUpdateInterval;
+		UpdateStreamingChunks();
+	}
 }
 
 void ASplinePlacementActor::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
@@ -477,12 +1713,9 @@ void ASplinePlacementActor::PostEditUndo()
 {
 	Super::PostEditUndo();
 
-	// Recalculate locations
-	PlaceInstancesAlongSpline();
-
-	// Place splines
-	RecalculateSplineMeshes();
-	PlaceSplineMeshComponentsAlongSpline();
+	// Transactions only hold the inputs, so throw away whatever was generated and rebuild from them
+	DestroyGeneratedComponents();
+	RebuildPlacement();
 }
 
 void ASplinePlacementActor::PostEditImport()
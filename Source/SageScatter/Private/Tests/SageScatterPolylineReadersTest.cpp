@@ -0,0 +1,111 @@
+// 2023 Green Rain Studios
+
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "SageScatterPolylineReaders.h"
+
+namespace
+{
+	using FPolylines = TArray<TArray<FVector>>;
+
+	// Feed the text to a reader in chunks of the given size, the way the importer feeds file chunks. Size 0 feeds it whole
+	template <typename ReaderType, typename... ArgTypes>
+	FPolylines ReadPolylines(const ANSICHAR* Text, int32 ChunkSize, ArgTypes... Args)
+	{
+		FPolylines polylines;
+		auto onPolyline = [&polylines](TArray<FVector>& Points) { polylines.Add(Points); };
+		ReaderType reader(onPolyline, Args...);
+
+		const int32 length = FCStringAnsi::Strlen(Text);
+		const int32 step = ChunkSize > 0 ? ChunkSize : FMath::Max(length, 1);
+		for(int32 offset = 0; offset < length; offset += step)
+		{
+			reader.Consume(Text + offset, FMath::Min(step, length - offset));
+		}
+
+		reader.Finish();
+		return polylines;
+	}
+
+	// Read the text whole and split at every position a small chunk size puts a boundary, and expect the same
+	// polylines every time
+	template <typename ReaderType, typename... ArgTypes>
+	void TestReader(FAutomationTestBase& Test, const TCHAR* What, const ANSICHAR* Text, const FPolylines& Expected, ArgTypes... Args)
+	{
+		for(const int32 chunkSize : {0, 1, 2, 3, 5, 7})
+		{
+			const FPolylines polylines = ReadPolylines<ReaderType>(Text, chunkSize, Args...);
+			const FString context = FString::Printf(TEXT("%s (chunk size %d)"), What, chunkSize);
+			if(!Test.TestEqual(*(context + TEXT(": polylines")), polylines.Num(), Expected.Num()))
+				continue;
+
+			for(int i = 0; i < polylines.Num(); i++)
+			{
+				Test.TestTrue(*FString::Printf(TEXT("%s: polyline %d"), *context, i), polylines[i] == Expected[i]);
+			}
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSageScatterCsvReaderTest, "SageScatter.Import.CsvReader",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FSageScatterCsvReaderTest::RunTest(const FString& Parameters)
+{
+	TestReader<FCsvPolylineReader>(*this, TEXT("Header, points and blank row"),
+		"x,y,z\r\n1,2,3\r\n4,5,6\r\n\r\n7,8\r\n9,10",
+		{{FVector(1, 2, 3), FVector(4, 5, 6)}, {FVector(7, 8, 0), FVector(9, 10, 0)}}, false);
+
+	TestReader<FCsvPolylineReader>(*this, TEXT("Id column with two coordinates"),
+		"id,x,y\n1,0,0\n1,10,0\n2,5,5\n2,6,6\n",
+		{{FVector(0, 0, 0), FVector(10, 0, 0)}, {FVector(5, 5, 0), FVector(6, 6, 0)}}, true);
+
+	TestReader<FCsvPolylineReader>(*this, TEXT("Id column with three coordinates"),
+		"a, 1, 2, 3\na, 4, 5, 6\n",
+		{{FVector(1, 2, 3), FVector(4, 5, 6)}}, true);
+
+	TestReader<FCsvPolylineReader>(*this, TEXT("Rows without digits are skipped"),
+		"-,1\n.,e\n1.5,-2e1\n",
+		{{FVector(1.5, -20, 0)}}, false);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSageScatterGeoJsonReaderTest, "SageScatter.Import.GeoJsonReader",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FSageScatterGeoJsonReaderTest::RunTest(const FString& Parameters)
+{
+	TestReader<FGeoJsonPolylineReader>(*this, TEXT("LineString and MultiLineString"),
+		R"({"type":"FeatureCollection","features":[
+			{"type":"Feature","properties":{"type":"road"},"geometry":{"type":"LineString","coordinates":[[0,0],[10,0,5]]}},
+			{"type":"Feature","geometry":{"type":"MultiLineString","coordinates":[[[1,1],[2,2]],[[3,3],[4,4]]]}}]})",
+		{{FVector(0, 0, 0), FVector(10, 0, 5)}, {FVector(1, 1, 0), FVector(2, 2, 0)}, {FVector(3, 3, 0), FVector(4, 4, 0)}});
+
+	TestReader<FGeoJsonPolylineReader>(*this, TEXT("Polygon rings"),
+		R"({"type":"Polygon","coordinates":[[[0,0],[1,0],[1,1],[0,0]]]})",
+		{{FVector(0, 0, 0), FVector(1, 0, 0), FVector(1, 1, 0), FVector(0, 0, 0)}});
+
+	TestReader<FGeoJsonPolylineReader>(*this, TEXT("Point and MultiPoint are skipped"),
+		R"([{"type":"Point","coordinates":[5,5]},
+			{"type":"MultiPoint","coordinates":[[1,2],[3,4]]},
+			{"type":"LineString","coordinates":[[0,0],[1,1]]}])",
+		{{FVector(0, 0, 0), FVector(1, 1, 0)}});
+
+	TestReader<FGeoJsonPolylineReader>(*this, TEXT("Type after coordinates"),
+		R"([{"coordinates":[[1,2],[3,4]],"type":"MultiPoint"},
+			{"coordinates":[[5,6],[7,8]],"type":"LineString"},
+			{"coordinates":[[9,9],[8,8]]}])",
+		{{FVector(5, 6, 0), FVector(7, 8, 0)}, {FVector(9, 9, 0), FVector(8, 8, 0)}});
+
+	TestReader<FGeoJsonPolylineReader>(*this, TEXT("Numbers without digits are rejected"),
+		R"({"type":"LineString","coordinates":[[-,1],[2,3],[-1.5e1,4]]})",
+		{{FVector(2, 3, 0), FVector(-15, 4, 0)}});
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,281 @@
+// 2023 Green Rain Studios
+
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_EDITOR
+
+#include "SageScatter.h"
+#include "SplinePlacementActor.h"
+#include "Editor.h"
+#include "EngineUtils.h"
+#include "Engine/NetDriver.h"
+#include "Engine/StaticMesh.h"
+#include "Settings/LevelEditorPlaySettings.h"
+#include "Tests/AutomationCommon.h"
+#include "Tests/AutomationEditorCommon.h"
+#include <atomic>
+
+namespace
+{
+	// Listen server plus this many clients, all in one process
+	constexpr int32 NumTestClients = 2;
+	constexpr double PIETimeout = 30.0;
+
+	// Counts the warnings clients log when their placement checksum does not match the server's
+	class FDivergenceLogCapture : public FOutputDevice
+	{
+	public:
+		FDivergenceLogCapture() { GLog->AddOutputDevice(this); }
+		virtual ~FDivergenceLogCapture() override { GLog->RemoveOutputDevice(this); }
+
+		virtual void Serialize(const TCHAR* V, ELogVerbosity::Type Verbosity, const FName& Category) override
+		{
+			if(Category == LogSageScatter.GetCategoryName() && FCString::Strifind(V, TEXT("placement diverged")) != nullptr)
+				NumDivergences++;
+		}
+
+		virtual bool CanBeUsedOnAnyThread() const override { return true; }
+
+		std::atomic<int32> NumDivergences = 0;
+	};
+
+	struct FReplicationTestState
+	{
+		TUniquePtr<FDivergenceLogCapture> DivergenceLog = MakeUnique<FDivergenceLogCapture>();
+		TWeakObjectPtr<ASplinePlacementActor> ServerActor;
+		TWeakObjectPtr<ASplinePlacementActor> StreamingActor;
+		uint64 ServerBytesBeforeSpawn = 0;
+		double StartTime = 0.0;
+	};
+
+	UWorld* FindPIEWorld(ENetMode NetMode, int32 Index = 0)
+	{
+		for(const FWorldContext& context : GEngine->GetWorldContexts())
+		{
+			UWorld* world = context.World();
+			if(context.WorldType == EWorldType::PIE && world != nullptr && world->GetNetMode() == NetMode && Index-- == 0)
+				return world;
+		}
+
+		return nullptr;
+	}
+
+	ASplinePlacementActor* FindPlacementActor(UWorld* World)
+	{
+		TActorIterator<ASplinePlacementActor> it(World);
+		return it ? *it : nullptr;
+	}
+
+	void GetAllInstances(const ASplinePlacementActor* Actor, TArray<FPlacedInstance>& OutInstances)
+	{
+		Actor->GetInstancesInDistanceRange(0, 0.f, TNumericLimits<float>::Max(), OutInstances);
+	}
+
+	void AddCubeProfile(ASplinePlacementActor* Actor)
+	{
+		FMeshProfileInstance& meshProfile = Actor->InstancedMeshes.AddDefaulted_GetRef();
+		meshProfile.MeshData.Mesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+		meshProfile.PlacementType = EInstancePlacementType::IPT_GAP;
+		meshProfile.Gap = 50.f;
+	}
+
+	bool HasTimedOut(FAutomationTestBase* Test, const FReplicationTestState& State, const TCHAR* WaitingFor)
+	{
+		if(FPlatformTime::Seconds() - State.StartTime < PIETimeout)
+			return false;
+
+		Test->AddError(FString::Printf(TEXT("Timed out waiting for %s"), WaitingFor));
+		return true;
+	}
+}
+
+// Wait until the server and every client have connected
+DEFINE_LATENT_AUTOMATION_COMMAND_TWO_PARAMETER(FWaitForPIEClients, FAutomationTestBase*, Test, TSharedRef<FReplicationTestState>, State);
+bool FWaitForPIEClients::Update()
+{
+	UWorld* serverWorld = FindPIEWorld(NM_ListenServer);
+	if(serverWorld != nullptr && serverWorld->GetNetDriver() != nullptr && serverWorld->GetNetDriver()->ClientConnections.Num() == NumTestClients)
+		return true;
+
+	return HasTimedOut(Test, *State, TEXT("PIE clients to connect"));
+}
+
+// Spawn a placement actor with jittered gap placement on the server
+DEFINE_LATENT_AUTOMATION_COMMAND_TWO_PARAMETER(FSpawnServerPlacementActor, FAutomationTestBase*, Test, TSharedRef<FReplicationTestState>, State);
+bool FSpawnServerPlacementActor::Update()
+{
+	UWorld* serverWorld = FindPIEWorld(NM_ListenServer);
+	if(serverWorld == nullptr || serverWorld->GetNetDriver() == nullptr)
+	{
+		Test->AddError(TEXT("No listen server world to spawn into"));
+		return true;
+	}
+
+	State->ServerBytesBeforeSpawn = serverWorld->GetNetDriver()->OutTotalBytes;
+	State->StartTime = FPlatformTime::Seconds();
+
+	ASplinePlacementActor* actor = serverWorld->SpawnActorDeferred<ASplinePlacementActor>(ASplinePlacementActor::StaticClass(), FTransform::Identity);
+	if(actor == nullptr)
+	{
+		Test->AddError(TEXT("Could not spawn a placement actor on the server"));
+		return true;
+	}
+
+	actor->Seed = 1234;
+
+	FMeshProfileInstance& meshProfile = actor->InstancedMeshes.AddDefaulted_GetRef();
+	meshProfile.MeshData.Mesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	FWeightedMesh& variant = meshProfile.MeshVariants.AddDefaulted_GetRef();
+	variant.Mesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cylinder.Cylinder"));
+	variant.Weight = 0.5f;
+	meshProfile.PlacementType = EInstancePlacementType::IPT_GAP;
+	meshProfile.Gap = 50.f;
+	meshProfile.Variation.GapJitter = 40.f;
+	meshProfile.Variation.LocationJitter = FVector(20.f, 20.f, 0.f);
+	meshProfile.Variation.RotationJitter = FRotator(0.f, 180.f, 0.f);
+	meshProfile.Variation.MinScale = 0.5f;
+	meshProfile.Variation.MaxScale = 1.5f;
+	actor->FinishSpawning(FTransform::Identity);
+
+	actor->SetSplinePointsBatched({FVector(0.f), FVector(5000.f, 0.f, 0.f), FVector(5000.f, 5000.f, 500.f), FVector(0.f, 5000.f, 0.f)}, ESplineCoordinateSpace::Local);
+	State->ServerActor = actor;
+	return true;
+}
+
+// Wait until every client regenerated as many instances as the server, then compare them instance by instance
+DEFINE_LATENT_AUTOMATION_COMMAND_TWO_PARAMETER(FCompareClientPlacement, FAutomationTestBase*, Test, TSharedRef<FReplicationTestState>, State);
+bool FCompareClientPlacement::Update()
+{
+	const ASplinePlacementActor* serverActor = State->ServerActor.Get();
+	if(serverActor == nullptr)
+	{
+		Test->AddError(TEXT("Server placement actor is missing"));
+		return true;
+	}
+
+	TArray<FPlacedInstance> serverInstances;
+	GetAllInstances(serverActor, serverInstances);
+
+	TArray<TArray<FPlacedInstance>, TInlineAllocator<NumTestClients>> clientInstances;
+	for(int i = 0; i < NumTestClients; i++)
+	{
+		UWorld* clientWorld = FindPIEWorld(NM_Client, i);
+		const ASplinePlacementActor* clientActor = clientWorld != nullptr ? FindPlacementActor(clientWorld) : nullptr;
+		if(clientActor == nullptr)
+			return HasTimedOut(Test, *State, TEXT("the placement actor to replicate"));
+
+		GetAllInstances(clientActor, clientInstances.AddDefaulted_GetRef());
+		if(clientInstances.Last().Num() != serverInstances.Num())
+			return HasTimedOut(Test, *State, TEXT("clients to regenerate placement"));
+	}
+
+	Test->TestTrue(TEXT("Server placed instances"), serverInstances.Num() > 0);
+	for(int i = 0; i < clientInstances.Num(); i++)
+	{
+		for(int j = 0; j < serverInstances.Num(); j++)
+		{
+			const FPlacedInstance& server = serverInstances[j];
+			const FPlacedInstance& client = clientInstances[i][j];
+			if(client.InstanceIdx != server.InstanceIdx || client.MeshIdx != server.MeshIdx || !FMath::IsNearlyEqual(client.Distance, server.Distance, 0.01f)
+				|| !client.RelativeLocation.Equals(server.RelativeLocation, 0.01f))
+			{
+				Test->AddError(FString::Printf(TEXT("Client %d diverged from the server at instance %d"), i, server.InstanceIdx));
+				break;
+			}
+		}
+	}
+
+	// Clients verify their checksum against the server's as soon as they have regenerated
+	Test->TestEqual(TEXT("Placement divergence warnings"), State->DivergenceLog->NumDivergences.load(), 0);
+
+	// Everything the server sent since the spawn, which is the replicated inputs plus connection overhead
+	const UNetDriver* netDriver = serverActor->GetWorld()->GetNetDriver();
+	const uint64 bytesSent = netDriver->OutTotalBytes - State->ServerBytesBeforeSpawn;
+	UE_LOG(LogSageScatter, Display, TEXT("Replicated %d instances to %d clients with %llu bytes sent by the server (%llu per client)"),
+		serverInstances.Num(), NumTestClients, bytesSent, bytesSent / NumTestClients);
+	return true;
+}
+
+// Spawn a long placement actor streaming by distance on the server, of which only the start is near the viewers
+DEFINE_LATENT_AUTOMATION_COMMAND_TWO_PARAMETER(FSpawnStreamingPlacementActor, FAutomationTestBase*, Test, TSharedRef<FReplicationTestState>, State);
+bool FSpawnStreamingPlacementActor::Update()
+{
+	UWorld* serverWorld = FindPIEWorld(NM_ListenServer);
+	ASplinePlacementActor* actor = serverWorld != nullptr ? serverWorld->SpawnActorDeferred<ASplinePlacementActor>(ASplinePlacementActor::StaticClass(), FTransform::Identity) : nullptr;
+	if(actor == nullptr)
+	{
+		Test->AddError(TEXT("Could not spawn a streaming placement actor on the server"));
+		return true;
+	}
+
+	State->StartTime = FPlatformTime::Seconds();
+
+	actor->bStreamByDistance = true;
+	actor->StreamingChunkLength = 2000.f;
+	actor->StreamingDistance = 3000.f;
+	AddCubeProfile(actor);
+	actor->FinishSpawning(FTransform::Identity);
+
+	actor->SetSplinePointsBatched({FVector(0.f), FVector(100000.f, 0.f, 0.f)}, ESplineCoordinateSpace::Local);
+	State->StreamingActor = actor;
+	return true;
+}
+
+// Wait until the chunks near the viewers are generated, then check that queries see them and only them
+DEFINE_LATENT_AUTOMATION_COMMAND_TWO_PARAMETER(FCheckStreamedQueries, FAutomationTestBase*, Test, TSharedRef<FReplicationTestState>, State);
+bool FCheckStreamedQueries::Update()
+{
+	const ASplinePlacementActor* actor = State->StreamingActor.Get();
+	if(actor == nullptr)
+	{
+		Test->AddError(TEXT("Streaming placement actor is missing"));
+		return true;
+	}
+
+	TArray<FPlacedInstance> nearInstances;
+	actor->GetInstancesInDistanceRange(0, 0.f, 2000.f, nearInstances);
+	if(nearInstances.Num() == 0)
+		return HasTimedOut(Test, *State, TEXT("streamed instances to be indexed"));
+
+	FPlacedInstance nearest;
+	Test->TestTrue(TEXT("Nearest instance found in a streamed chunk"), actor->FindNearestInstance(0, actor->GetActorLocation(), nearest));
+	FPlacedInstance first;
+	Test->TestTrue(TEXT("Streamed instance found by index"), actor->FindInstance(0, nearInstances[0].InstanceIdx, first));
+
+	TArray<FPlacedInstance> farInstances;
+	actor->GetInstancesInDistanceRange(0, 90000.f, 100000.f, farInstances);
+	Test->TestEqual(TEXT("Instances of chunks far from every viewer"), farInstances.Num(), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSplinePlacementReplicationTest, "SageScatter.Replication.ClientsMatchServer",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FSplinePlacementReplicationTest::RunTest(const FString& Parameters)
+{
+	FAutomationEditorCommonUtils::CreateNewMap();
+
+	ULevelEditorPlaySettings* playSettings = NewObject<ULevelEditorPlaySettings>();
+	playSettings->SetPlayNetMode(EPlayNetMode::PIE_ListenServer);
+	playSettings->SetPlayNumberOfClients(NumTestClients + 1);
+	playSettings->SetRunUnderOneProcess(true);
+
+	FRequestPlaySessionParams params;
+	params.WorldType = EPlaySessionWorldType::PlayInEditor;
+	params.EditorPlaySettings = playSettings;
+	GEditor->RequestPlaySession(params);
+
+	TSharedRef<FReplicationTestState> state = MakeShared<FReplicationTestState>();
+	state->StartTime = FPlatformTime::Seconds();
+
+	ADD_LATENT_AUTOMATION_COMMAND(FWaitForPIEClients(this, state));
+	ADD_LATENT_AUTOMATION_COMMAND(FSpawnServerPlacementActor(this, state));
+	ADD_LATENT_AUTOMATION_COMMAND(FCompareClientPlacement(this, state));
+	ADD_LATENT_AUTOMATION_COMMAND(FSpawnStreamingPlacementActor(this, state));
+	ADD_LATENT_AUTOMATION_COMMAND(FCheckStreamedQueries(this, state));
+	ADD_LATENT_AUTOMATION_COMMAND(FEndPlayMapCommand());
+	return true;
+}
+
+#endif
@@ -5,6 +5,9 @@
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogSageScatter, Log, All);
+DECLARE_STATS_GROUP(TEXT("SageScatter"), STATGROUP_SageScatter, STATCAT_Advanced);
+
 class FSageScatterModule : public IModuleInterface
 {
 public:
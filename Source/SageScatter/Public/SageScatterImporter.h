@@ -0,0 +1,38 @@
+// 2023 Green Rain Studios
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "SageScatterImporter.generated.h"
+
+class ASplinePlacementActor;
+
+UENUM(BlueprintType, meta=(DisplayName="Spline Import Format"))
+enum class ESplineImportFormat : uint8
+{
+	// One x,y[,z] point per row, optionally after a polyline id column. A new polyline starts whenever the id changes.
+	// Blank rows also end a polyline, and rows that are not numeric (headers) are skipped
+	SIF_CSV			UMETA(DisplayName = "CSV"),
+	// Every LineString, MultiLineString or Polygon ring in the file's coordinates becomes a polyline. Point and
+	// MultiPoint geometry is skipped
+	SIF_GEOJSON		UMETA(DisplayName = "GeoJSON")
+};
+
+/**
+ * Bulk import of polylines into spline placement actors
+ */
+UCLASS()
+class SAGESCATTER_API USageScatterImporter : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+	// Stream polylines from a CSV or GeoJSON file into spline placement actors. The first polyline goes into Target, and
+	// every further polyline (or piece of one longer than MaxActorLength, when set) gets its own copy of Target. Each
+	// actor gets its points in one batch and rebuilds placement once. Coordinates are mapped to world space with
+	// CoordinateTransform. CSV files with bHasIdColumn read their first column as the polyline id. In the editor the
+	// whole import is one undoable transaction. Returns all actors that received points
+	UFUNCTION(BlueprintCallable, Category="SageScatter|Import")
+	static TArray<ASplinePlacementActor*> ImportSplinesFromFile(ASplinePlacementActor* Target, const FString& FilePath, ESplineImportFormat Format, FTransform CoordinateTransform, float MaxActorLength = 0.f, bool bHasIdColumn = false);
+};
@@ -6,6 +6,21 @@
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "SageScatterUtils.generated.h"
 
+UENUM(BlueprintType, meta=(DisplayName="Placement Collision Mode"))
+enum class EPlacementCollisionMode : uint8
+{
+	PCM_NONE			UMETA(DisplayName = "No collision"),
+	PCM_PER_INSTANCE	UMETA(DisplayName = "Per instance collision"),
+	PCM_MERGED			UMETA(DisplayName = "Merged collision proxy")
+};
+
+UENUM(BlueprintType, meta=(DisplayName="Collision Proxy Shape"))
+enum class ECollisionProxyShape : uint8
+{
+	CPS_BOX			UMETA(DisplayName = "Boxes"),
+	CPS_CONVEX		UMETA(DisplayName = "Convex hulls")
+};
+
 USTRUCT(BlueprintType)
 struct FMeshProfile
 {
@@ -16,9 +31,55 @@ struct FMeshProfile
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile")
 	FTransform Offset = FTransform::Identity;
+
+	// Per instance keeps each mesh's own collision. Merged replaces it with one simplified chain along the spline
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile|Collision")
+	EPlacementCollisionMode CollisionMode = EPlacementCollisionMode::PCM_PER_INSTANCE;
+
+	// Boxes are cheapest. Convex hulls also follow twist and taper between the ends of each piece
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile|Collision", meta=(EditCondition="CollisionMode==EPlacementCollisionMode::PCM_MERGED", EditConditionHides))
+	ECollisionProxyShape ProxyShape = ECollisionProxyShape::CPS_BOX;
+
+	// How far the merged chain may stray from the spline. Higher values give fewer, longer pieces
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile|Collision", meta=(ClampMin = 1, EditCondition="CollisionMode==EPlacementCollisionMode::PCM_MERGED", EditConditionHides))
+	float CollisionTolerance = 10.f;
 	
 };
 
+// Counter-based random stream. Every draw is a pure hash of the stream key and a draw counter, so a stream keyed on
+// seed, profile and instance gives the same values no matter the order (or thread) instances are evaluated in
+struct SAGESCATTER_API FSageScatterRandom
+{
+	FSageScatterRandom(int32 Seed, int32 Profile, int32 Instance, int32 Channel = 0);
+
+	// Random value in [0, 1)
+	float GetFraction();
+	// Random value in [Min, Max]
+	float GetInRange(float Min, float Max);
+	// Random value in [-Extent, Extent]
+	float GetSigned(float Extent);
+
+private:
+	uint64 Key;
+	uint32 Counter = 0;
+};
+
+// Alias table for O(1) weighted picks (Vose's method). Zero or negative weights are never picked
+struct SAGESCATTER_API FSageScatterAliasTable
+{
+	// Rebuild the table for the given weights. Leaves the table empty if no weight is positive
+	void Build(TConstArrayView<float> Weights);
+
+	// Pick an index with probability proportional to its weight. Returns INDEX_NONE for an empty table
+	int32 Pick(FSageScatterRandom& Random) const;
+
+	bool IsEmpty() const { return Probabilities.Num() == 0; }
+
+private:
+	TArray<float> Probabilities;
+	TArray<int32> Aliases;
+};
+
 /**
  * 
  */
@@ -33,4 +94,7 @@ public:
 	static FVector CalculateOffsets(FVector Offset, FVector Forward, FVector Right, FVector Up);
 	UFUNCTION(BlueprintPure, Category="SageScatter|Helper")
 	static FRotator MakeRotatorFromAxes(FVector Forward, FVector Right, FVector Up);
+
+	// Accumulate a transform into a running CRC. Values are quantized first so checksums ignore float noise
+	static uint32 HashTransform(const FTransform& Transform, uint32 Crc);
 };
@@ -0,0 +1,31 @@
+// 2023 Green Rain Studios
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "PhysicsEngine/AggregateGeom.h"
+#include "SplineCollisionComponent.generated.h"
+
+class UBodySetup;
+
+// Invisible primitive that only carries simple collision shapes, used for merged collision proxies along a spline
+UCLASS(ClassGroup=(SageScatter), meta=(DisplayName="Spline Collision Component"))
+class SAGESCATTER_API USplineCollisionComponent : public UPrimitiveComponent
+{
+	GENERATED_BODY()
+
+public:
+	USplineCollisionComponent();
+
+	// Replace all collision shapes, in component space. Does nothing when they are unchanged, otherwise updates the body
+	// setup in place and recreates the physics state
+	void SetCollisionGeometry(const FKAggregateGeom& Geometry);
+
+	virtual UBodySetup* GetBodySetup() override;
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+protected:
+	UPROPERTY(Transient)
+	UBodySetup* CollisionBodySetup;
+};
@@ -4,10 +4,15 @@
 
 #include "CoreMinimal.h"
 #include "PlacementActorBase.h"
+#include "Components/SplineComponent.h"
 #include "Components/SplineMeshComponent.h"
+#include "Async/Future.h"
+#include "PhysicsEngine/AggregateGeom.h"
 #include "SplinePlacementActor.generated.h"
 
 class ULocalLightComponent;
+class UHierarchicalInstancedStaticMeshComponent;
+class USplineCollisionComponent;
 
 UENUM(BlueprintType, meta=(DisplayName="Instance Placement Type"))
 enum class EInstancePlacementType : uint8
@@ -67,6 +72,48 @@ struct FLightProfile
 	
 };
 
+// This structure represents the random variation applied to each mesh instance. All values are +/- ranges around the
+// profile offset, so a default constructed variation leaves instances untouched
+USTRUCT(BlueprintType)
+struct FInstanceVariation
+{
+	GENERATED_BODY()
+
+	// Location jitter along the spline's forward, right and up directions
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Variation", meta=(ClampMin = 0))
+	FVector LocationJitter = FVector::ZeroVector;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Variation", meta=(ClampMin = 0))
+	FRotator RotationJitter = FRotator::ZeroRotator;
+
+	// Scale multiplier range applied on top of the profile scale
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Variation", meta=(ClampMin = 0))
+	float MinScale = 1.f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Variation", meta=(ClampMin = 0))
+	float MaxScale = 1.f;
+
+	// Jitter added to the gap between instances. Only used when placing with gap
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Variation", meta=(ClampMin = 0))
+	float GapJitter = 0.f;
+
+	// One random per instance custom data float for each range (X = min, Y = max)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Variation")
+	TArray<FVector2D> CustomDataRanges;
+};
+
+// A mesh that can be picked for an instance, with its relative weight
+USTRUCT(BlueprintType)
+struct FWeightedMesh
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile")
+	UStaticMesh* Mesh = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile", meta=(ClampMin = 0))
+	float Weight = 1.f;
+};
+
 // This structure represents all the data needed to create mesh instances
 USTRUCT(BlueprintType)
 struct FMeshProfileInstance
@@ -75,6 +122,14 @@ struct FMeshProfileInstance
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile", meta=(ShowOnlyInnerProperties))
 	FMeshProfile MeshData;
 
+	// Weight of the main mesh when picking between it and the mesh variants
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile", meta=(ClampMin = 0))
+	float MeshWeight = 1.f;
+
+	// Additional meshes picked per instance by weight. They share the main mesh's offset
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile")
+	TArray<FWeightedMesh> MeshVariants;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile")
 	EInstancePlacementType PlacementType;
 	
@@ -84,14 +139,89 @@ struct FMeshProfileInstance
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile", meta=(EditCondition="PlacementType==EInstancePlacementType::IPT_Gap", EditConditionHides))
 	float StartOffset = 0.f;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile")
+	FInstanceVariation Variation;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile")
 	bool bActivateLight;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Mesh Profile|Light", meta=(EditCondition="bActivateLight", EditConditionHides))
 	FLightProfile LightData;
 
-	UPROPERTY()
+	// Generated components are never saved or replicated, they are regenerated from the inputs
+	UPROPERTY(Transient, NotReplicated)
 	TArray<ULocalLightComponent*> PLCs;
+
+	// One ISM per mesh index, null where the mesh is not set
+	UPROPERTY(Transient, NotReplicated)
+	TArray<UHierarchicalInstancedStaticMeshComponent*> ISMs;
+
+	// Meshes are indexed with the main mesh at 0, followed by the mesh variants
+	int32 GetNumMeshes() const { return MeshVariants.Num() + 1; }
+	UStaticMesh* GetMesh(int32 Index) const { return Index == 0 ? MeshData.Mesh : MeshVariants[Index - 1].Mesh; }
+	float GetMeshWeight(int32 Index) const
+	{
+		if(GetMesh(Index) == nullptr)
+			return 0.f;
+		return Index == 0 ? MeshWeight : MeshVariants[Index - 1].Weight;
+	}
+};
+
+// A single generated instance of a mesh profile, in placement order
+struct FInstancePlacement
+{
+	FTransform Transform;
+	// Distance along the spline the instance was placed at
+	float Distance = 0.f;
+	// Index of the instance in its profile, which keys all of its random streams
+	int32 InstanceIdx = 0;
+	// Mesh index picked for this instance, and the instance index inside that mesh's ISM
+	int32 MeshIdx = 0;
+	int32 ComponentInstance = INDEX_NONE;
+};
+
+// A generated instance, as returned by the instance queries
+USTRUCT(BlueprintType)
+struct FPlacedInstance
+{
+	GENERATED_BODY()
+
+	// Index of the instance in its profile
+	UPROPERTY(BlueprintReadOnly, Category="Placed Instance")
+	int32 InstanceIdx = INDEX_NONE;
+
+	// Distance along the spline the instance was placed at
+	UPROPERTY(BlueprintReadOnly, Category="Placed Instance")
+	float Distance = 0.f;
+
+	// Location relative to the actor, with offsets and variation applied
+	UPROPERTY(BlueprintReadOnly, Category="Placed Instance")
+	FVector RelativeLocation = FVector::ZeroVector;
+
+	// Mesh index picked for the instance
+	UPROPERTY(BlueprintReadOnly, Category="Placed Instance")
+	int32 MeshIdx = 0;
+
+	// The ISM holding the instance, and the instance's index inside it
+	UPROPERTY(BlueprintReadOnly, Category="Placed Instance")
+	UHierarchicalInstancedStaticMeshComponent* ISM = nullptr;
+	UPROPERTY(BlueprintReadOnly, Category="Placed Instance")
+	int32 ComponentInstance = INDEX_NONE;
+
+	// Only set when the profile activates lights
+	UPROPERTY(BlueprintReadOnly, Category="Placed Instance")
+	ULocalLightComponent* Light = nullptr;
+};
+
+// All generated instances of a profile, sorted by distance along the spline. Placement walks the spline forwards, so
+// instance indices are sorted too
+USTRUCT()
+struct FProfileInstanceIndex
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient)
+	TArray<FPlacedInstance> Instances;
 };
 
 // This structure represents all the data needed to create spline meshes
@@ -126,6 +256,120 @@ struct FMeshProfileSpline
 	float MeshLength = 100.f;
 };
 
+// A single generated spline mesh, in local space
+struct FSplineMeshSegment
+{
+	UStaticMesh* Mesh = nullptr;
+	float StartDistance = 0.f;
+	FVector StartLocation;
+	FVector StartTangent;
+	FVector EndLocation;
+	FVector EndTangent;
+	EPlacementCollisionMode CollisionMode = EPlacementCollisionMode::PCM_PER_INSTANCE;
+};
+
+// A range of the spline whose content is generated and destroyed as a unit when streaming by distance
+USTRUCT()
+struct FPlacementChunk
+{
+	GENERATED_BODY()
+
+	float StartDistance = 0.f;
+	float EndDistance = 0.f;
+
+	// World space bounds of the spline over this range
+	FVector Center = FVector::ZeroVector;
+	float Radius = 0.f;
+
+	// Whether a viewer is close enough for this chunk to be wanted, whether it has a build in flight, and whether its
+	// content currently exists
+	bool bWanted = false;
+	bool bPending = false;
+	bool bResident = false;
+
+	// Everything generated for this chunk
+	UPROPERTY(Transient)
+	TArray<UActorComponent*> Components;
+};
+
+// Where a profile's gap walk enters a range: the first instance at or past the range start, and its distance
+struct FGapWalkState
+{
+	int32 InstanceIdx = 0;
+	float Distance = 0.f;
+};
+
+// Copy of the placement inputs that chunk builds read from worker threads
+struct FPlacementSnapshot
+{
+	// Unregistered copy of the spline, kept alive by the actor until all builds reading it are done
+	const USplineComponent* Spline = nullptr;
+	FVector ActorLocation = FVector::ZeroVector;
+	int32 Seed = 0;
+	float SplineLength = 0.f;
+	TArray<FMeshProfileInstance> InstancedMeshes;
+	TArray<FSageScatterAliasTable> MeshTables;
+	TArray<FMeshProfileSpline> SplineMeshes;
+	// Gap walk state at the start of every chunk, per instanced mesh profile. Empty for profiles not placed with gap
+	TArray<TArray<FGapWalkState>> ChunkStarts;
+	// Distances the merged collision of each instanced mesh profile spans over the whole spline. Chunks clip it to
+	// their own range, so streamed collision is as continuous as a full build's
+	TArray<FVector2D> CollisionRanges;
+};
+
+// Output of a chunk build, applied on the game thread
+struct FChunkBuildResult
+{
+	int32 ChunkIdx = INDEX_NONE;
+	// Placements per instanced mesh profile
+	TArray<TArray<FInstancePlacement>> Instances;
+	TArray<FSplineMeshSegment> Segments;
+	// Merged collision shapes, one entry per profile using merged collision
+	TArray<FKAggregateGeom> CollisionProxies;
+};
+
+// Spline samples a merged collision proxy is fitted to
+struct FCollisionProxySamples
+{
+	TArray<FVector> Locations;
+	TArray<FVector> Rights;
+	TArray<FVector> Ups;
+	// Samples a piece ends at, and ranges of samples still to be split
+	TArray<bool> PieceEnds;
+	TArray<FIntPoint> OpenRanges;
+};
+
+// Working memory of a full rebuild. It is kept between rebuilds and only ever reset, so once it has grown to fit the
+// inputs, rebuilding does not grow it again
+struct FPlacementScratch
+{
+	// Placements of the profile being built
+	TArray<FInstancePlacement> Placements;
+	// Instance transforms of each ISM of the profile being built, added to it as one batch
+	TArray<TArray<FTransform>> MeshTransforms;
+	TArray<int32> MeshCounts;
+	TArray<float> CustomData;
+	TArray<FSplineMeshSegment> Segments;
+	FSageScatterAliasTable MeshTable;
+	// Merged collision. Geometry is kept per profile, so convex pieces keep their vertex memory between rebuilds
+	FCollisionProxySamples ProxySamples;
+	TArray<FKAggregateGeom> InstanceProxyGeometry;
+	TArray<FKAggregateGeom> SplineProxyGeometry;
+};
+
+// Compact copy of the spline, replicated so clients can regenerate placement themselves
+USTRUCT()
+struct FReplicatedSplineData
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FSplinePoint> Points;
+
+	UPROPERTY()
+	bool bClosedLoop = false;
+};
+
 UCLASS(Blueprintable, meta=(DisplayName="Spline Placement Actor", PrioritizeCategories="Setup"))
 class SAGESCATTER_API ASplinePlacementActor : public APlacementActorBase
 {
@@ -137,6 +381,41 @@ public:
 	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void PostInitProperties() override;
+	virtual void PostRegisterAllComponents() override;
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PostNetReceive() override;
+
+	// Regenerate all placement from the spline and profiles. On the server this also pushes the inputs to clients
+	UFUNCTION(BlueprintCallable, Category="SageScatter")
+	void RebuildPlacement();
+
+	// Replace all spline points in one batch, so the spline and its reparam table are only updated once. Then
+	// optionally run a single placement rebuild
+	UFUNCTION(BlueprintCallable, Category="SageScatter")
+	void SetSplinePointsBatched(const TArray<FVector>& Points, ESplineCoordinateSpace::Type CoordinateSpace, bool bRebuildPlacement = true);
+
+	// Instance queries, all O(log n) in the number of instances of the profile. While streaming by distance they only
+	// see instances of chunks that are currently generated
+
+	// Find the instance of a profile closest to a world location, looking either side of the location's projection
+	// onto the spline
+	UFUNCTION(BlueprintCallable, Category="SageScatter|Query")
+	bool FindNearestInstance(int32 ProfileIdx, const FVector& WorldLocation, FPlacedInstance& OutInstance) const;
+
+	// Get all instances of a profile placed between MinDistance and MaxDistance (both inclusive) along the spline
+	UFUNCTION(BlueprintCallable, Category="SageScatter|Query")
+	void GetInstancesInDistanceRange(int32 ProfileIdx, float MinDistance, float MaxDistance, TArray<FPlacedInstance>& OutInstances) const;
+
+	// Find an instance of a profile by its index in the profile
+	UFUNCTION(BlueprintCallable, Category="SageScatter|Query")
+	bool FindInstance(int32 ProfileIdx, int32 InstanceIdx, FPlacedInstance& OutInstance) const;
+
+	// Get the light of an instance, if its profile activates lights
+	UFUNCTION(BlueprintCallable, Category="SageScatter|Query")
+	ULocalLightComponent* GetInstanceLight(int32 ProfileIdx, int32 InstanceIdx) const;
 
 #if WITH_EDITOR
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
@@ -155,10 +434,46 @@ protected:
 	// Place instances of meshes along the spline
 	void PlaceInstancesAlongSpline();
 
+	// Placement calculations only read the spline they are given, so chunk builds can run them against a copy
+
+	// Calculate the placements of a profile that fall between MinDistance (inclusive) and MaxDistance (exclusive). Gap
+	// placement walks from GapStart when given, which has to lie at or before MinDistance, and from the start otherwise
+	static void CalculateProfilePlacements(const USplineComponent* InSpline, int32 InSeed, float SplineLength, int ProfileIdx, const FMeshProfileInstance& MeshProfile, const FSageScatterAliasTable& MeshTable, const FGapWalkState* GapStart, float MinDistance, float MaxDistance, TArray<FInstancePlacement> &OutPlacements);
 	// Place instances along spline at regular distances
-	bool CalculateTransformsAtRegularDistances(float SplineLength, FMeshProfileInstance MeshProfile, TArray<FTransform> &OutTransforms);
+	static bool CalculateTransformsAtRegularDistances(const USplineComponent* InSpline, int32 InSeed, float SplineLength, int ProfileIdx, const FMeshProfileInstance& MeshProfile, const FSageScatterAliasTable& MeshTable, const FGapWalkState* GapStart, float MinDistance, float MaxDistance, TArray<FInstancePlacement> &OutPlacements);
 	// Place instances along spline at spline points
-	bool CalculateTransformsAtSplinePoints(FMeshProfileInstance MeshProfile, TArray<FTransform> &OutTransforms);
+	static bool CalculateTransformsAtSplinePoints(const USplineComponent* InSpline, int32 InSeed, int ProfileIdx, const FMeshProfileInstance& MeshProfile, const FSageScatterAliasTable& MeshTable, float MinDistance, float MaxDistance, TArray<FInstancePlacement> &OutPlacements);
+
+	// Add placements to the ISM of their picked mesh, one batch per ISM, and record their index inside it
+	void AddPlacementsToISMs(const TArray<UHierarchicalInstancedStaticMeshComponent*>& MeshISMs, TArray<FInstancePlacement>& Placements);
+
+	// Build the weighted table a profile picks its meshes from
+	static void BuildMeshTable(const FMeshProfileInstance& MeshProfile, FSageScatterAliasTable& OutTable);
+
+	// Distance from an instance of a gap walk to the next one, and the mesh of the next one
+	static float StepGapWalk(int32 InSeed, int ProfileIdx, const FMeshProfileInstance& MeshProfile, const FSageScatterAliasTable& MeshTable, int32 InstanceIdx, int32 MeshIdx, int32& OutNextMeshIdx);
+
+	// Pick the mesh index for a single instance of a profile
+	static int32 PickInstanceMesh(int32 InSeed, int ProfileIdx, int InstanceIdx, const FSageScatterAliasTable& MeshTable);
+
+	// Half length of a profile mesh along the spline, with the profile scale applied
+	static float GetScaledMeshHalfLength(const FMeshProfileInstance& MeshProfile, int32 MeshIdx);
+
+	// Half length of the shortest mesh a profile can pick. Max float when it cannot pick any
+	static float GetMinScaledMeshHalfLength(const FMeshProfileInstance& MeshProfile);
+
+	// Apply the profile's random variation for a single instance to an already offset transform
+	static void ApplyInstanceVariation(const FInstanceVariation& Variation, FSageScatterRandom& Random, const FVector& Fwd, const FVector& Right, const FVector& Up, FVector& Location, FRotator& Rotation, FVector& Scale);
+
+	// Write the profile's random per instance custom data into the ISMs of its meshes
+	void ApplyInstanceCustomData(int32 InSeed, int ProfileIdx, const FMeshProfileInstance& MeshProfile, const TArray<UHierarchicalInstancedStaticMeshComponent*>& MeshISMs, const TArray<FInstancePlacement>& Placements);
+
+	// Add placements of a profile to its index. Placements have to be sorted by distance, and either all lie past the
+	// indexed ones or fill a range that was removed before. Lights are matched to placements by position, when given
+	void IndexPlacements(int ProfileIdx, const TArray<FInstancePlacement>& Placements, const TArray<UHierarchicalInstancedStaticMeshComponent*>& MeshISMs, TConstArrayView<ULocalLightComponent*> Lights);
+
+	// Remove indexed instances of all profiles between MinDistance (inclusive) and MaxDistance (exclusive)
+	void RemoveIndexedRange(float MinDistance, float MaxDistance);
 
 	// Spline Mesh placement functions
 	void RecalculateSplineMeshes();
@@ -166,38 +481,164 @@ protected:
 	// Place Spline Mesh components
 	void PlaceSplineMeshComponentsAlongSpline();
 
-	// Create required number of lights based on length of spline and gap
-	void CreateLCs(const int idx);
+	// Calculate the spline meshes of all profiles that start between MinDistance (inclusive) and MaxDistance (exclusive)
+	static void CalculateSplineMeshSegments(const USplineComponent* InSpline, const FVector& ActorLocation, const TArray<FMeshProfileSpline>& Profiles, float MinDistance, float MaxDistance, TArray<FSplineMeshSegment>& OutSegments);
+
+	// Create required number of lights, one per placed instance
+	void CreateLCs(const int idx, const int NumInstances);
 
 	// Update Existing Lights
-	void UpdateLCs(const int idx);
+	void UpdateLCs(const int idx, const TArray<FInstancePlacement>& Placements);
+
+	// Collision for generated components of a profile. Only per instance collision keeps it
+	static ECollisionEnabled::Type GetGeneratedCollision(const FMeshProfile& MeshData);
+
+	// Bounds of a mesh with the profile scale applied. Instance profiles use the union of all their meshes
+	static FBox GetScaledMeshBox(const FMeshProfile& MeshData, const UStaticMesh* Mesh);
+	static FBox GetScaledMeshBox(const FMeshProfileInstance& MeshProfile);
+
+	// Distance range a spline mesh profile covers
+	static void GetSplineMeshProfileRange(const FMeshProfileSpline& MeshProfile, float SplineLength, float& OutStartDistance, float& OutEndDistance);
+
+	// Build a simplified chain of collision shapes with the mesh's cross section, following the spline between two distances.
+	// Replaces the shapes in OutGeometry, reusing the memory of its convex pieces. Samples is working memory, reused
+	// between calls
+	static void CalculateCollisionProxy(const USplineComponent* InSpline, const FMeshProfile& MeshData, const FBox& MeshBox, float StartDistance, float EndDistance, FCollisionProxySamples& Samples, FKAggregateGeom& OutGeometry);
+
+	// Keep one merged collision proxy slot per profile, destroying the proxies of removed profiles
+	static void ResizeCollisionProxies(TArray<USplineCollisionComponent*>& Proxies, int32 NumProfiles);
+	static void DestroyCollisionProxy(USplineCollisionComponent*& Proxy);
 
-	FTransform GetTransformAtDistanceAlongSpline(float Distance);
-	void GetDirectionVectorsAtDistanceAlongSpline(float Distance, FVector& Fwd, FVector& Right, FVector& Up);
+	// Create, update or destroy a profile's merged collision proxy to match its collision mode. Geometry is the profile's
+	// scratch geometry
+	void UpdateCollisionProxy(USplineCollisionComponent*& Proxy, FKAggregateGeom& Geometry, const FMeshProfile& MeshData, const FBox& MeshBox, float StartDistance, float EndDistance);
+
+	// Create a single registered light of the profile's type
+	ULocalLightComponent* CreateLC(const FLightProfile& LightProfile);
+
+	// Light transform for an instance, relative to the actor
+	static FTransform CalculateLightTransform(const FLightProfile& LightProfile, const FTransform& InstanceTransform);
+
+	static FTransform GetTransformAtDistanceAlongSpline(const USplineComponent* InSpline, float Distance);
+	static void GetDirectionVectorsAtDistanceAlongSpline(const USplineComponent* InSpline, float Distance, FVector& Fwd, FVector& Right, FVector& Up);
 
 	// Update properties of a single light from profile
 	void UpdateLightPropertiesFromProfile(const FLightProfile& LightProfile, ULocalLightComponent* Light);
 
+	// Networking. Only the inputs are replicated, and clients compare their result against the server's checksum
+	void CaptureReplicatedSpline();
+	void ApplyReplicatedSpline();
+	void VerifyPlacementChecksum();
+	uint32 CalculatePlacementChecksum() const;
+
+	// Create a transient component attached to the root, ready to be set up and registered
+	template <typename T>
+	T* NewGeneratedComponent();
+
+	// Whether a component is generated output, as opposed to part of the actor's own setup
+	static bool IsGeneratedComponent(const UActorComponent* Component);
+	
+	// Destroy all generated output, including anything our arrays lost track of
+	void DestroyGeneratedComponents();
+
+	// Streaming by distance
+	bool IsStreamingByDistance() const;
+	void ResetStreamingChunks();
+	void UpdateStreamingChunks();
+	void StartChunkBuild(int32 ChunkIdx);
+	void FinishChunkBuild(FChunkBuildResult& Result);
+	void UnloadChunk(int32 ChunkIdx);
+	void WaitForChunkBuilds();
+
+	UFUNCTION()
+	void OnRep_PlacementInputs();
+	UFUNCTION()
+	void OnRep_PlacementChecksum();
+
 public:
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Setup", meta=(ShowOnlyInnerProperties))
+	// Seed for all instance variation. Each instance draws from its own stream keyed on this, its profile and its index
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, ReplicatedUsing=OnRep_PlacementInputs, Category="Setup")
+	int32 Seed = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, ReplicatedUsing=OnRep_PlacementInputs, Category="Setup", meta=(ShowOnlyInnerProperties))
 	TArray<FMeshProfileInstance> InstancedMeshes;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Setup", meta=(ShowOnlyInnerProperties))
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, ReplicatedUsing=OnRep_PlacementInputs, Category="Setup", meta=(ShowOnlyInnerProperties))
 	TArray<FMeshProfileSpline> SplineMeshes;
 
+	// At runtime, only generate content near viewers, in chunks along the spline. The editor always generates everything
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Streaming")
+	bool bStreamByDistance = false;
+
+	// Length of spline covered by a single chunk
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Streaming", meta=(ClampMin = 100, EditCondition="bStreamByDistance"))
+	float StreamingChunkLength = 5000.f;
+
+	// Chunks closer than this to a viewer are generated
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Streaming", meta=(ClampMin = 0, EditCondition="bStreamByDistance"))
+	float StreamingDistance = 10000.f;
+
+	// Extra distance a chunk has to move out past the streaming distance before it is destroyed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Streaming", meta=(ClampMin = 0, EditCondition="bStreamByDistance"))
+	float StreamingHysteresis = 2000.f;
+
+	// Seconds between viewer distance checks
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Streaming", meta=(ClampMin = 0, EditCondition="bStreamByDistance"))
+	float StreamingUpdateInterval = 0.25f;
+
+	// Maximum number of chunks built on worker threads at once
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Streaming", meta=(ClampMin = 1, EditCondition="bStreamByDistance"))
+	int32 MaxPendingChunkBuilds = 2;
+
 protected:
 	UPROPERTY(VisibleDefaultsOnly)
-	class USplineComponent* Spline;
+	USplineComponent* Spline;
 
 	UPROPERTY()
 	UBillboardComponent* Icn;
 
-	UPROPERTY()
-	TArray<class UHierarchicalInstancedStaticMeshComponent*> ISMs;
+	// All ISMs of all profiles
+	UPROPERTY(Transient)
+	TArray<UHierarchicalInstancedStaticMeshComponent*> ISMs;
 
-	UPROPERTY()
+	UPROPERTY(Transient)
 	TArray<USplineMeshComponent*> SMCs;
 
+	// Merged collision proxies by profile, null where a profile has none. They live here rather than in the profiles,
+	// so copying or removing a profile in the details panel never shares or leaks a proxy
+	UPROPERTY(Transient)
+	TArray<USplineCollisionComponent*> InstanceCollisionProxies;
+	UPROPERTY(Transient)
+	TArray<USplineCollisionComponent*> SplineCollisionProxies;
+
+	UPROPERTY(Transient, ReplicatedUsing=OnRep_PlacementInputs)
+	FReplicatedSplineData ReplicatedSpline;
+
+	// Checksum of the server's generated placement, 0 when unknown
+	UPROPERTY(Transient, ReplicatedUsing=OnRep_PlacementChecksum)
+	uint32 ServerPlacementChecksum;
+
+	// Generated instances of each profile, for queries
+	UPROPERTY(Transient)
+	TArray<FProfileInstanceIndex> InstanceIndex;
+
+	UPROPERTY(Transient)
+	TArray<FPlacementChunk> Chunks;
+
+	// Copy of the spline the current snapshot was taken from
+	UPROPERTY(Transient)
+	USplineComponent* StreamingSpline;
+
+	// Inputs and in flight builds for streaming by distance
+	TSharedPtr<const FPlacementSnapshot> StreamingSnapshot;
+	TArray<TFuture<FChunkBuildResult>> ChunkBuilds;
+	float StreamingUpdateTimer;
+
+	// Reused by every rebuild on the game thread
+	FPlacementScratch Scratch;
+
 	// Internal flags
 	bool bForceUnloadLights;
+	bool bPendingNetRebuild;
+	bool bPendingChecksumCheck;
 };
@@ -39,8 +39,14 @@ public class SageScatter: ModuleRules
 				"Core",
 				"CoreUObject",
 				"Engine",
+				"PhysicsCore",
 				"Slate",
 			});
+
+		if (Target.bBuildEditor)
+		{
+			PrivateDependencyModuleNames.Add("UnrealEd");
+		}
 		
 		DynamicallyLoadedModuleNames.AddRange(
 			new string[]